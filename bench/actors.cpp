@@ -0,0 +1,95 @@
+/*
+ * Throughput of the actor runtime (libs/actor.h)
+ *
+ * Some producer threads send messages round-robin to thousands of
+ * actors that share a small ActorPool. We measure how many messages
+ * per second are processed for different batch sizes (how many
+ * messages an actor processes each time that it is scheduled).
+ *
+ * Usage:
+ *   ./bench/actors.exe [actors] [messages] [workers] [producers]
+ * */
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include "../libs/actor.h"
+
+class Counter : public Actor<unsigned int> {
+    public:
+        unsigned long sum = 0;
+
+        explicit Counter(ActorPool& pool) : Actor<unsigned int>(pool) {}
+
+        virtual void receive(const unsigned int& n) override {
+            sum += n;
+        }
+};
+
+class Producer : public Thread {
+    private:
+        std::vector<Counter*>& actors;
+        const unsigned long messages;
+        const unsigned int first;
+
+    public:
+        Producer(std::vector<Counter*>& actors, unsigned long messages, unsigned int first) :
+            actors(actors), messages(messages), first(first) {}
+
+        virtual void run() override {
+            size_t i = first;
+            for (unsigned long m = 0; m < messages; ++m) {
+                actors[i]->send(1);
+                if (++i == actors.size())
+                    i = 0;
+            }
+        }
+};
+
+int main(int argc, char *argv[]) {
+    const unsigned int actors_cnt = argc > 1 ? atoi(argv[1]) : 2000;
+    const unsigned long messages = argc > 2 ? atol(argv[2]) : 4000000;
+    const unsigned int workers_cnt = argc > 3 ? atoi(argv[3]) : std::thread::hardware_concurrency();
+    const unsigned int producers_cnt = argc > 4 ? atoi(argv[4]) : 2;
+
+    std::cout << "actors,workers,producers,batch,messages,seconds,msg_per_sec\n";
+
+    for (size_t batch : {1, 8, 64, 512}) {
+        ActorPool pool(workers_cnt, batch);
+        std::vector<Counter*> actors(actors_cnt);
+        for (unsigned int i = 0; i < actors_cnt; ++i) {
+            actors[i] = new Counter(pool);
+        }
+
+        std::vector<Thread*> producers;
+        for (unsigned int p = 0; p < producers_cnt; ++p) {
+            producers.push_back(new Producer(actors, messages / producers_cnt,
+                                             p * actors_cnt / producers_cnt));
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        for (Thread *t : producers) {
+            t->start();
+        }
+        for (Thread *t : producers) {
+            t->join();
+            delete t;
+        }
+        pool.wait_idle();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        unsigned long total = 0;
+        for (Counter *a : actors) {
+            total += a->sum;
+            delete a;
+        }
+
+        std::cout << actors_cnt << "," << workers_cnt << "," << producers_cnt << ","
+                  << batch << "," << total << "," << elapsed.count() << ","
+                  << (unsigned long)(total / elapsed.count()) << "\n";
+    }
+
+    return 0;
+}
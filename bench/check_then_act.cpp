@@ -0,0 +1,140 @@
+/*
+ * Check-then-act critical sections: mutex monitor vs CAS
+ *
+ * Like AreAnyPrime in 08_monitor_interface_critical_section.cpp,
+ * each thread reads the shared result very often (get_val()) and
+ * from time to time it tries a conditional update
+ * (inc_if_below(limit), a generalization of inc_if_you_are_zero)
+ *
+ *  - mutex: the monitor of 08, every read and update takes the mutex
+ *  - cas:   a std::atomic; reads are plain loads and the conditional
+ *           update is an update_if (libs/atomic_ops.h)
+ *
+ * Usage:
+ *   ./bench/check_then_act.exe [ops per thread] [max threads] [write every]
+ * */
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+
+#include "../libs/thread.h"
+#include "../libs/atomic_ops.h"
+
+class ResultProtected {
+    private:
+        std::mutex m;
+        unsigned int result;
+
+    public:
+        explicit ResultProtected(unsigned int v) : result(v) {}
+
+        unsigned int get_val() {
+            std::unique_lock<std::mutex> lck(m);
+            return result;
+        }
+
+        bool inc_if_below(unsigned int limit) {
+            std::unique_lock<std::mutex> lck(m);
+            if (result < limit) {
+                ++result;
+                return true;
+            }
+            return false;
+        }
+};
+
+class ResultAtomic {
+    private:
+        std::atomic<unsigned int> result;
+
+    public:
+        explicit ResultAtomic(unsigned int v) : result(v) {}
+
+        unsigned int get_val() const {
+            return result.load(std::memory_order_acquire);
+        }
+
+        bool inc_if_below(unsigned int limit) {
+            return update_if(result,
+                    [limit](unsigned int v) { return v < limit; },
+                    [](unsigned int v) { return v + 1; });
+        }
+};
+
+template<class Result>
+class Searcher : public Thread {
+    private:
+        Result& result;
+        const unsigned long ops;
+        const unsigned long write_every;
+        const unsigned int limit;
+
+    public:
+        unsigned long sink = 0;
+
+        Searcher(Result& result, unsigned long ops, unsigned long write_every, unsigned int limit) :
+            result(result), ops(ops), write_every(write_every), limit(limit) {}
+
+        virtual void run() override {
+            for (unsigned long i = 1; i <= ops; ++i) {
+                if (i % write_every == 0) {
+                    result.inc_if_below(limit);
+                } else {
+                    sink += result.get_val();
+                }
+            }
+        }
+};
+
+template<class Result>
+void measure(const std::string& name, unsigned int threads_cnt, unsigned long ops,
+             unsigned long write_every) {
+    const unsigned int limit = threads_cnt * (ops / write_every) / 2;
+    Result result(0);
+
+    std::vector<Thread*> threads;
+    for (unsigned int i = 0; i < threads_cnt; ++i) {
+        threads.push_back(new Searcher<Result>(result, ops, write_every, limit));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+
+    if (result.get_val() != limit) {
+        std::cerr << name << ": wrong result " << result.get_val() << " != " << limit << "\n";
+        exit(1);
+    }
+
+    std::cout << name << "," << threads_cnt << "," << write_every << ","
+              << elapsed.count() / (ops * threads_cnt) << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    const unsigned long ops = argc > 1 ? atol(argv[1]) : 200000;
+    const unsigned int max_threads = argc > 2 ? atoi(argv[2]) : 64;
+    const unsigned long write_every = argc > 3 ? atol(argv[3]) : 100;
+
+    if (write_every == 0) {
+        std::cerr << "write_every must be greater than 0\n";
+        return 1;
+    }
+
+    std::cout << "monitor,threads,write_every,ns_per_op\n";
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        measure<ResultProtected>("mutex", threads, ops, write_every);
+        measure<ResultAtomic>("cas", threads, ops, write_every);
+    }
+
+    return 0;
+}
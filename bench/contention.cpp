@@ -0,0 +1,253 @@
+/*
+ * The same reduction (the sum of an array split among threads, like
+ * 04..07) with each way of sharing the result:
+ *
+ *  - race:    a plain load and store, the lost updates of 04 (done
+ *             with relaxed atomics so the compiler cannot keep the
+ *             result in a register: the race is in the hardware)
+ *  - mutex:   std::mutex and a lock_guard, as in 05 and 06 (both pay
+ *             the same lock and unlock)
+ *  - monitor: Monitor<unsigned long> (libs/monitor.h), the 07 and 08
+ *             critical section as a lambda
+ *  - atomic:  a single std::atomic and fetch_add
+ *  - sharded: ShardedCounter (libs/sharded_counter.h), one cache line
+ *             per thread
+ *  - local:   a local accumulator per thread and a single combine at
+ *             the end (no sharing until then)
+ *
+ * The total work is fixed (strong scaling): each thread sums its slice
+ * and publishes its partial sum to the shared result every
+ * elems_per_update elements (1 is the 04..07 pattern: one update per
+ * element). local publishes only once, so it has a single row per
+ * count of threads.
+ *
+ * We report:
+ *
+ *  - ns_per_elem: wall time / elements
+ *  - speedup: the time with 1 thread / the time with n threads, for
+ *    the same strategy and update frequency (the scaling curve)
+ *  - vol_cs, invol_cs: the context switches of all the threads
+ *    (ThreadStats); a contended mutex puts the threads to sleep
+ *  - correct: 0 if updates were lost
+ *
+ * Usage:
+ *   ./bench/contention.exe [elements] [max threads]
+ * */
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <map>
+#include <cstdlib>
+#include <cstdint>
+
+#include "../libs/thread.h"
+#include "../libs/thread_stats.h"
+#include "../libs/monitor.h"
+#include "../libs/sharded_counter.h"
+
+class Racy {
+    private:
+        std::atomic<unsigned long> result;
+
+    public:
+        Racy() : result(0) {}
+
+        // Not atomic as a whole: two threads may read the same value
+        void add(unsigned long s) {
+            result.store(result.load(std::memory_order_relaxed) + s, std::memory_order_relaxed);
+        }
+
+        unsigned long get() const {
+            return result.load();
+        }
+};
+
+class Locked {
+    private:
+        std::mutex m;
+        unsigned long result;
+
+    public:
+        Locked() : result(0) {}
+
+        void add(unsigned long s) {
+            std::lock_guard<std::mutex> lck(m);
+            result += s;
+        }
+
+        unsigned long get() {
+            std::lock_guard<std::mutex> lck(m);
+            return result;
+        }
+};
+
+class Monitored {
+    private:
+        Monitor<unsigned long> result;
+
+    public:
+        Monitored() : result(0ul) {}
+
+        void add(unsigned long s) {
+            result.with([s](unsigned long& r) { r += s; });
+        }
+
+        unsigned long get() const {
+            return result.read([](const unsigned long& r) { return r; });
+        }
+};
+
+class Atomic {
+    private:
+        std::atomic<unsigned long> result;
+
+    public:
+        Atomic() : result(0) {}
+
+        void add(unsigned long s) {
+            result.fetch_add(s, std::memory_order_relaxed);
+        }
+
+        unsigned long get() const {
+            return result.load();
+        }
+};
+
+class Sharded {
+    private:
+        ShardedCounter<unsigned long> result;
+
+    public:
+        Sharded() : result(0, ShardedCounter<unsigned long>::BY_THREAD) {}
+
+        void add(unsigned long s) {
+            result.inc(s);
+        }
+
+        unsigned long get() const {
+            return result.get_val();
+        }
+};
+
+template<class Result>
+class Summer : public Thread {
+    private:
+        Result& result;
+        const uint32_t *nums;
+        const size_t first;
+        const size_t last;
+        const size_t elems_per_update;
+
+    public:
+        Summer(Result& result, const uint32_t *nums, size_t first, size_t last, size_t elems_per_update) :
+            result(result), nums(nums), first(first), last(last),
+            elems_per_update(elems_per_update) {}
+
+        virtual void run() override {
+            unsigned long partial = 0;
+            size_t pending = 0;
+            for (size_t i = first; i < last; ++i) {
+                partial += nums[i];
+                if (++pending == elems_per_update) {
+                    result.add(partial);
+                    partial = 0;
+                    pending = 0;
+                }
+            }
+            if (pending) {
+                result.add(partial);
+            }
+        }
+};
+
+struct Row {
+    double ns_per_elem;
+    long vol_cs;
+    long invol_cs;
+    bool correct;
+};
+
+template<class Result>
+Row measure(const std::vector<uint32_t>& nums, unsigned long expected,
+            unsigned int threads_cnt, size_t elems_per_update) {
+    Result result;
+    std::vector<Thread*> threads;
+    for (unsigned int t = 0; t < threads_cnt; ++t) {
+        const size_t first = nums.size() * t / threads_cnt;
+        const size_t last = nums.size() * (t+1) / threads_cnt;
+        threads.push_back(new Summer<Result>(result, nums.data(), first, last, elems_per_update));
+        threads.back()->enable_stats("summer");
+    }
+
+    ThreadStatsRegistry::instance().clear();
+    auto begin = std::chrono::steady_clock::now();
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+
+    Row row = {elapsed.count() / nums.size(), 0, 0, result.get() == expected};
+    for (const ThreadStats& s : ThreadStatsRegistry::instance().get_all()) {
+        row.vol_cs += s.voluntary_ctxsw;
+        row.invol_cs += s.involuntary_ctxsw;
+    }
+    return row;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t elements = argc > 1 ? atol(argv[1]) : 1 << 24;
+    const unsigned int max_threads = argc > 2 ? atoi(argv[2]) : 2 * std::thread::hardware_concurrency();
+
+    std::vector<uint32_t> nums(elements);
+    unsigned long expected = 0;
+    for (size_t i = 0; i < elements; ++i) {
+        nums[i] = (uint32_t)(i * 2654435761u) >> 8;
+        expected += nums[i];
+    }
+
+    typedef Row (*Measure)(const std::vector<uint32_t>&, unsigned long, unsigned int, size_t);
+    const std::pair<const char*, Measure> strategies[] = {
+        {"race", measure<Racy>},
+        {"mutex", measure<Locked>},
+        {"monitor", measure<Monitored>},
+        {"atomic", measure<Atomic>},
+        {"sharded", measure<Sharded>},
+    };
+    const size_t frequencies[] = {1, 16, 256, 4096};
+
+    // The time with 1 thread of each strategy and frequency
+    std::map<std::pair<std::string, size_t>, double> single;
+
+    auto print = [&](const std::string& name, unsigned int threads, size_t per_update, const Row& row) {
+        auto key = std::make_pair(name, per_update);
+        if (threads == 1) {
+            single[key] = row.ns_per_elem;
+        }
+        std::cout << name << "," << threads << ","
+                  << (per_update == SIZE_MAX ? std::string("all") : std::to_string(per_update)) << ","
+                  << elements << "," << row.ns_per_elem << "," << single[key] / row.ns_per_elem << ","
+                  << row.vol_cs << "," << row.invol_cs << "," << row.correct << "\n";
+    };
+
+    std::cout << "strategy,threads,elems_per_update,elements,ns_per_elem,speedup,vol_cs,invol_cs,correct\n";
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        for (const auto& strategy : strategies) {
+            for (size_t per_update : frequencies) {
+                print(strategy.first, threads, per_update,
+                      strategy.second(nums, expected, threads, per_update));
+            }
+        }
+
+        // A single update per thread, at the end
+        print("local", threads, SIZE_MAX, measure<Atomic>(nums, expected, threads, SIZE_MAX));
+    }
+
+    return 0;
+}
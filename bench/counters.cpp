@@ -0,0 +1,131 @@
+/*
+ * Cost of incrementing a shared counter from many threads:
+ *
+ *  - mutex:   the monitor ResultProtected of 07_sumatoria_with_monitor.cpp
+ *  - atomic:  a single std::atomic with fetch_add
+ *  - sharded: ShardedCounter (libs/sharded_counter.h), by thread and by cpu
+ *
+ * Each thread does the same count of increments; we report the
+ * nanoseconds per increment of the whole program (wall time / total
+ * increments of all the threads). It is the inverse of the throughput:
+ * if the counter scaled, it would halve each time the threads double.
+ *
+ * Usage:
+ *   ./bench/counters.exe [increments per thread] [max threads]
+ * */
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+
+#include "../libs/thread.h"
+#include "../libs/sharded_counter.h"
+
+class ResultProtected {
+    private:
+        std::mutex m;
+        unsigned long result;
+
+    public:
+        explicit ResultProtected(unsigned long v) : result(v) {}
+
+        void inc(unsigned long s) {
+            std::unique_lock<std::mutex> lck(m);
+            result += s;
+        }
+
+        unsigned long get_val() {
+            std::unique_lock<std::mutex> lck(m);
+            return result;
+        }
+};
+
+class AtomicCounter {
+    private:
+        std::atomic<unsigned long> result;
+
+    public:
+        explicit AtomicCounter(unsigned long v) : result(v) {}
+
+        void inc(unsigned long s) {
+            result.fetch_add(s, std::memory_order_relaxed);
+        }
+
+        unsigned long get_val() const {
+            return result.load(std::memory_order_relaxed);
+        }
+};
+
+template<class Counter>
+class Incrementer : public Thread {
+    private:
+        Counter& counter;
+        const unsigned long cnt;
+
+    public:
+        Incrementer(Counter& counter, unsigned long cnt) : counter(counter), cnt(cnt) {}
+
+        virtual void run() override {
+            for (unsigned long i = 0; i < cnt; ++i) {
+                counter.inc(1);
+            }
+        }
+};
+
+template<class Counter>
+void measure(const std::string& name, Counter& counter, unsigned int threads_cnt,
+             unsigned long incs_per_thread) {
+    std::vector<Thread*> threads;
+    for (unsigned int i = 0; i < threads_cnt; ++i) {
+        threads.push_back(new Incrementer<Counter>(counter, incs_per_thread));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+
+    const unsigned long total = incs_per_thread * threads_cnt;
+    if (counter.get_val() != total) {
+        std::cerr << name << ": wrong count " << counter.get_val() << " != " << total << "\n";
+        exit(1);
+    }
+
+    std::cout << name << "," << threads_cnt << "," << total << ","
+              << elapsed.count() / total << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    const unsigned long incs_per_thread = argc > 1 ? atol(argv[1]) : 200000;
+    const unsigned int max_threads = argc > 2 ? atoi(argv[2]) : 128;
+
+    std::cout << "counter,threads,increments,ns_per_inc\n";
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        {
+            ResultProtected counter(0);
+            measure("mutex", counter, threads, incs_per_thread);
+        }
+        {
+            AtomicCounter counter(0);
+            measure("atomic", counter, threads, incs_per_thread);
+        }
+        {
+            ShardedCounter<unsigned long> counter(0, ShardedCounter<unsigned long>::BY_THREAD);
+            measure("sharded_by_thread", counter, threads, incs_per_thread);
+        }
+        {
+            ShardedCounter<unsigned long> counter(0, ShardedCounter<unsigned long>::BY_CPU);
+            measure("sharded_by_cpu", counter, threads, incs_per_thread);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Cost of the factorization (libs/factorize.h) of 64 bits numbers:
+ *
+ *  - random:     uniform random 64 bits numbers
+ *  - semiprime:  products of two random ~32 bits primes, the worst case
+ *                of Pollard's rho
+ *  - nums:       the nums of 03_is_prime_parallel_by_inheritance.cpp
+ *
+ * For each input set and count of threads, factorize_all() runs over all
+ * the numbers. We report the nanoseconds per number of a single thread
+ * calling factorize() and the aggregated numbers per second of
+ * factorize_all() (the caller plus threads - 1 in the pool).
+ *
+ * Usage:
+ *   ./bench/factorize.exe [numbers] [max threads]
+ * */
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <cstdlib>
+
+#include "../libs/factorize.h"
+
+template<class F>
+double measure_s(F f) {
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count();
+}
+
+uint64_t random_prime(std::mt19937_64& gen) {
+    uint64_t p = (gen() >> 32) | ((uint64_t)1 << 31) | 1;
+    while (not is_prime_fast(p)) {
+        p += 2;
+    }
+    return p;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t cnt = argc > 1 ? atol(argv[1]) : 20000;
+    const unsigned int max_threads = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+
+    std::mt19937_64 gen(42);
+    std::vector<std::pair<std::string, std::vector<uint64_t> > > sets(3);
+
+    sets[0].first = "random";
+    for (size_t i = 0; i < cnt; ++i) {
+        sets[0].second.push_back(gen());
+    }
+
+    sets[1].first = "semiprime";
+    for (size_t i = 0; i < cnt; ++i) {
+        sets[1].second.push_back(random_prime(gen) * random_prime(gen));
+    }
+
+    sets[2].first = "nums";
+    const uint64_t nums[] = { 1, 2, 3, 5, 132130891, 132130891, 4, 13, 132130891, 132130891 };
+    for (size_t i = 0; i < cnt; ++i) {
+        sets[2].second.push_back(nums[i % 10]);
+    }
+
+    std::cout << "set,threads,numbers,factors,ns_per_number,numbers_per_s\n";
+    for (const auto& set : sets) {
+        const std::vector<uint64_t>& input = set.second;
+
+        // A single thread, one number at a time
+        size_t factors = 0;
+        const double single = measure_s([&]() {
+            for (uint64_t n : input) {
+                factors += factorize(n).size();
+            }
+        });
+        std::cout << set.first << ",1," << input.size() << "," << factors << ","
+                  << single * 1e9 / input.size() << "," << input.size() / single << "\n";
+
+        for (unsigned int threads = 2; threads <= max_threads; threads *= 2) {
+            ThreadPool pool(threads - 1);
+            std::vector<std::vector<uint64_t> > out;
+            const double elapsed = measure_s([&]() {
+                factorize_all(input, out, pool);
+            });
+
+            factors = 0;
+            for (const auto& f : out) {
+                factors += f.size();
+            }
+            std::cout << set.first << "," << threads << "," << input.size() << "," << factors << ","
+                      << elapsed * 1e9 / input.size() << "," << input.size() / elapsed << "\n";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Flat combining vs a plain mutex monitor (libs/flat_combining.h,
+ * libs/monitor.h) over a std::map like the Attendance of 13_fixme.cpp
+ *
+ * Each thread marks the attendance of students: "add the student if it
+ * is not in the list and mark it as present" as a single critical
+ * section. We report the wall time over the operations of all the
+ * threads (ops per thread * threads): the map is a single critical
+ * section so at best it stays flat as threads are added, and it grows
+ * when they spend more time handing the lock than updating the map.
+ *
+ * Usage:
+ *   ./bench/flat_combining.exe [ops per thread] [max threads] [students]
+ * */
+#include <iostream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+
+#include "../libs/thread.h"
+#include "../libs/monitor.h"
+#include "../libs/flat_combining.h"
+
+typedef std::map<int, bool> Attendance;
+
+struct MutexList {
+    Monitor<Attendance> list;
+
+    void mark(int id) {
+        list.with([id](Attendance& l) { l[id] = true; });
+    }
+};
+
+struct CombiningList {
+    FlatCombining<Attendance> list;
+
+    void mark(int id) {
+        list.apply([id](Attendance& l) { l[id] = true; });
+    }
+};
+
+template<class List>
+class Student : public Thread {
+    private:
+        List& list;
+        const unsigned long ops;
+        const int students;
+        unsigned int seed;
+
+    public:
+        Student(List& list, unsigned long ops, int students, unsigned int seed) :
+            list(list), ops(ops), students(students), seed(seed) {}
+
+        virtual void run() override {
+            for (unsigned long i = 0; i < ops; ++i) {
+                seed = seed * 1103515245 + 12345;
+                list.mark((seed >> 8) % students);
+            }
+        }
+};
+
+template<class List>
+void measure(const std::string& name, unsigned int threads_cnt, unsigned long ops, int students) {
+    List list;
+
+    std::vector<Thread*> threads;
+    for (unsigned int i = 0; i < threads_cnt; ++i) {
+        threads.push_back(new Student<List>(list, ops, students, i + 1));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+
+    std::cout << name << "," << threads_cnt << "," << students << ","
+              << elapsed.count() / (ops * threads_cnt) << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    const unsigned long ops = argc > 1 ? atol(argv[1]) : 200000;
+    const unsigned int max_threads = argc > 2 ? atoi(argv[2]) : 64;
+    const int students = argc > 3 ? atoi(argv[3]) : 100;
+
+    std::cout << "monitor,threads,students,ns_per_op\n";
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        measure<MutexList>("mutex", threads, ops, students);
+        measure<CombiningList>("flat_combining", threads, ops, students);
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Cost of checking if a number is prime, one number at a time:
+ *
+ *  - trial:        IsPrime::run of 01..03 (divide by all the numbers
+ *                  below n); only for the nums of 03
+ *  - trial_sqrt:   the same up to sqrt(n)
+ *  - miller_rabin: is_prime_fast (libs/miller_rabin.h)
+ *  - batch_*:      is_prime_batch (libs/batch_primes.h), many numbers
+ *                  at once, one row per implementation that the CPU
+ *                  supports; only for the 32 bits numbers
+ *
+ * The inputs are the nums of 03_is_prime_parallel_by_inheritance.cpp and
+ * random 32 and 64 bits numbers (trial_sqrt only for the 32 bits ones).
+ * We report the nanoseconds per number.
+ *
+ * Usage:
+ *   ./bench/is_prime.exe [random numbers]
+ * */
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstdlib>
+
+#include "../libs/miller_rabin.h"
+#include "../libs/batch_primes.h"
+
+bool trial(uint64_t n) {
+    if (n < 2) return false;
+    for (uint64_t i = 2; i < n; ++i) {
+        if (n % i == 0) return false;
+    }
+    return true;
+}
+
+bool trial_sqrt(uint64_t n) {
+    if (n < 2) return false;
+    for (uint64_t i = 2; i * i <= n; ++i) {
+        if (n % i == 0) return false;
+    }
+    return true;
+}
+
+template<class F>
+void measure(const std::string& name, const std::string& input,
+             const std::vector<uint64_t>& nums, F f) {
+    auto begin = std::chrono::steady_clock::now();
+    size_t primes = 0;
+    for (uint64_t n : nums) {
+        primes += f(n);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+
+    std::cout << name << "," << input << "," << nums.size() << "," << primes << ","
+              << elapsed.count() / nums.size() << "\n";
+}
+
+void measure_batch(const std::string& input, const std::vector<uint64_t>& nums) {
+    std::vector<unsigned int> nums32(nums.begin(), nums.end());
+    std::vector<uint64_t> bitmap((nums.size() + 63) / 64);
+
+    for (TrialDivisionImpl impl : supported_trial_division_impls()) {
+        auto begin = std::chrono::steady_clock::now();
+        is_prime_batch(nums32.data(), nums32.size(), bitmap.data(), impl);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+
+        size_t primes = 0;
+        for (uint64_t w : bitmap) {
+            primes += __builtin_popcountll(w);
+        }
+
+        std::cout << "batch_" << trial_division_impl_name(impl) << "," << input << ","
+                  << nums.size() << "," << primes << "," << elapsed.count() / nums.size() << "\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const size_t cnt = argc > 1 ? atol(argv[1]) : 100000;
+
+    const std::vector<uint64_t> nums = { 0, 1, 2, 132130891,
+                                         132130891, 4, 13,
+                                         132130891, 132130891,
+                                         132130871 };
+
+    std::mt19937_64 gen(42);
+    std::vector<uint64_t> nums32(cnt), nums64(cnt);
+    for (size_t i = 0; i < cnt; ++i) {
+        nums32[i] = (uint32_t)gen();
+        nums64[i] = gen();
+    }
+
+    std::cout << "algorithm,input,numbers,primes,ns_per_number\n";
+    measure("trial", "nums", nums, trial);
+    measure("trial_sqrt", "nums", nums, trial_sqrt);
+    measure("miller_rabin", "nums", nums, is_prime_fast);
+    measure_batch("nums", nums);
+
+    measure("trial_sqrt", "random32", nums32, trial_sqrt);
+    measure("miller_rabin", "random32", nums32, is_prime_fast);
+    measure_batch("random32", nums32);
+    measure("miller_rabin", "random64", nums64, is_prime_fast);
+
+    return 0;
+}
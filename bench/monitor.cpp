@@ -0,0 +1,105 @@
+/*
+ * Read-mostly monitors: ExclusiveLock vs SharedLock vs SeqLock
+ * (libs/monitor.h)
+ *
+ * N reader threads call read() in a loop while one writer calls
+ * with() from time to time. We report the wall time divided by the
+ * reads of all the readers together: with reads that do not contend it
+ * goes down as readers are added (on enough cores).
+ *
+ * Usage:
+ *   ./bench/monitor.exe [reads per thread] [max readers]
+ * */
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <cstdlib>
+
+#include "../libs/thread.h"
+#include "../libs/monitor.h"
+
+struct Stats {
+    unsigned long present;
+    unsigned long absent;
+};
+
+template<class M>
+class Reader : public Thread {
+    private:
+        M& m;
+        const unsigned long reads;
+
+    public:
+        unsigned long sink = 0;
+
+        Reader(M& m, unsigned long reads) : m(m), reads(reads) {}
+
+        virtual void run() override {
+            for (unsigned long i = 0; i < reads; ++i) {
+                sink += m.read([](const Stats& s) { return s.present + s.absent; });
+            }
+        }
+};
+
+template<class M>
+class Writer : public Thread {
+    private:
+        M& m;
+
+    public:
+        explicit Writer(M& m) : m(m) {}
+
+        virtual void run() override {
+            while (should_keep_running()) {
+                m.with([](Stats& s) {
+                    ++s.present;
+                    --s.absent;
+                });
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+};
+
+template<class Policy>
+void measure(const std::string& name, unsigned int readers_cnt, unsigned long reads) {
+    Monitor<Stats, Policy> m(Stats{0, 1000000});
+
+    Writer<Monitor<Stats, Policy> > writer(m);
+    std::vector<Thread*> readers;
+    for (unsigned int i = 0; i < readers_cnt; ++i) {
+        readers.push_back(new Reader<Monitor<Stats, Policy> >(m, reads));
+    }
+
+    writer.start();
+    auto begin = std::chrono::steady_clock::now();
+    for (Thread *t : readers) {
+        t->start();
+    }
+    for (Thread *t : readers) {
+        t->join();
+        delete t;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    writer.stop();
+    writer.join();
+
+    std::cout << name << "," << readers_cnt << ","
+              << elapsed.count() / (reads * readers_cnt) << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    const unsigned long reads = argc > 1 ? atol(argv[1]) : 1000000;
+    const unsigned int max_readers = argc > 2 ? atoi(argv[2]) : 2 * std::thread::hardware_concurrency();
+
+    std::cout << "policy,readers,ns_per_read\n";
+    for (unsigned int readers = 1; readers <= max_readers; readers *= 2) {
+        measure<ExclusiveLock>("exclusive", readers, reads);
+        measure<SharedLock>("shared", readers, reads);
+        measure<SeqLock>("seqlock", readers, reads);
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Makespan of parallel_for (libs/parallel.h) with skewed per-item costs,
+ * like the nums of 02/03 (4 next to 132130891):
+ *
+ *  - one item of each 64 is 1000 times more expensive than the others
+ *    and the expensive ones are all in the first quarter of the range
+ *  - each item writes its result to a CacheAlignedVector<char>
+ *
+ * For each schedule (static, dynamic, guided), grain and count of
+ * threads we report the milliseconds.
+ *
+ * Usage:
+ *   ./bench/parallel_for.exe [items] [max threads]
+ * */
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <cstdlib>
+
+#include "../libs/parallel.h"
+
+unsigned long work(size_t i, unsigned long iterations) {
+    unsigned long acc = i;
+    for (unsigned long k = 0; k < iterations; ++k) {
+        acc = acc * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return acc;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t items = argc > 1 ? atol(argv[1]) : 100000;
+    const unsigned int max_threads = argc > 2 ? atoi(argv[2]) : 2 * std::thread::hardware_concurrency();
+
+    const Schedule schedules[] = {Schedule::STATIC, Schedule::DYNAMIC, Schedule::GUIDED};
+    const char *names[] = {"static", "dynamic", "guided"};
+
+    CacheAlignedVector<char> results(items);
+
+    auto body = [&results, items](size_t i) {
+        const bool expensive = i % 64 == 0 and i < items / 4;
+        results[i] = work(i, expensive ? 100000 : 100) & 1;
+    };
+
+    std::cout << "schedule,threads,grain,ms\n";
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        // The caller also works: a pool of threads - 1. A pool has at
+        // least 1 thread so the baseline (1 thread) is a plain loop in
+        // the caller, the same for every schedule and grain
+        std::unique_ptr<ThreadPool> pool;
+        if (threads > 1) {
+            pool.reset(new ThreadPool(threads - 1));
+        }
+
+        for (int s = 0; s < 3; ++s) {
+            for (size_t grain : {64, 1024}) {
+                auto begin = std::chrono::steady_clock::now();
+                if (pool) {
+                    parallel_for(0, items, body, schedules[s], grain, *pool);
+                } else {
+                    for (size_t i = 0; i < items; ++i) {
+                        body(i);
+                    }
+                }
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+
+                std::cout << names[s] << "," << threads << "," << grain << "," << elapsed.count() << "\n";
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Summation of a big array: sequential vs parallel_reduce (libs/parallel.h)
+ *
+ * The sum is done with a 64 bits accumulator so it does not
+ * overflow (Sum::run in 04..07 uses an unsigned int).
+ *
+ * For a big array the sum is limited by the memory bandwidth, not by
+ * the CPU: do not expect a speedup equal to the count of cores.
+ *
+ * The sum_array and parallel_sum rows use the vector kernels of
+ * libs/sum_kernels.h, one row per implementation that the CPU supports;
+ * the in_cache rows sum a slice of 8192 elements (32 KB, it fits in L1)
+ * over and over: there the kernels, not the memory, are the limit.
+ *
+ * Usage:
+ *   ./bench/parallel_reduce.exe [elements] [repetitions]
+ * */
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <cstdint>
+
+#include "../libs/parallel.h"
+#include "../libs/sum_kernels.h"
+
+template<class F>
+double best_of(int reps, F f) {
+    double best = 1e99;
+    for (int r = 0; r < reps; ++r) {
+        auto begin = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t n = argc > 1 ? atol(argv[1]) : (1 << 25);
+    const int reps = argc > 2 ? atoi(argv[2]) : 5;
+
+    std::vector<uint32_t> nums(n);
+    for (size_t i = 0; i < n; ++i) {
+        nums[i] = (uint32_t)(i * 2654435761u);
+    }
+
+    const double gb = n * sizeof(uint32_t) / 1e9;
+    volatile uint64_t sink;
+
+    std::cout << "method,threads,elements,seconds,GB_per_sec\n";
+
+    double secs = best_of(reps, [&]() {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += nums[i];
+        }
+        sink = acc;
+    });
+    const uint64_t expected = sink;
+    std::cout << "sequential,1," << n << "," << secs << "," << gb / secs << "\n";
+
+    // The caller also works: a pool of threads - 1 (0 workers for
+    // 1 thread, all runs in the caller)
+    for (unsigned int threads : {1u, 2u, 4u, 8u, ThreadPool::default_size()}) {
+        ThreadPool pool(threads - 1);
+        secs = best_of(reps, [&]() {
+            sink = parallel_reduce(nums.begin(), nums.end(), (uint64_t)0,
+                    [](uint32_t x) { return (uint64_t)x; },
+                    [](uint64_t a, uint64_t b) { return a + b; },
+                    pool);
+        });
+
+        if (sink != expected) {
+            std::cerr << "Wrong result\n";
+            return 1;
+        }
+        std::cout << "parallel_reduce," << threads << "," << n << "," << secs << "," << gb / secs << "\n";
+    }
+
+    const size_t slice = std::min(n, (size_t)8192);
+    const size_t rounds = n / slice;
+    for (SumImpl impl : supported_sum_impls()) {
+        const std::string name = sum_impl_name(impl);
+
+        secs = best_of(reps, [&]() {
+            uint64_t acc = 0;
+            for (size_t r = 0; r < rounds; ++r) {
+                acc += sum_array(nums.data(), slice, impl);
+            }
+            sink = acc;
+        });
+        std::cout << "in_cache_" << name << ",1," << slice * rounds << "," << secs << ","
+                  << slice * rounds * sizeof(uint32_t) / 1e9 / secs << "\n";
+
+        secs = best_of(reps, [&]() {
+            sink = sum_array(nums.data(), n, impl);
+        });
+        if (sink != expected) {
+            std::cerr << "Wrong result\n";
+            return 1;
+        }
+        std::cout << "sum_array_" << name << ",1," << n << "," << secs << "," << gb / secs << "\n";
+
+        for (unsigned int threads : {1u, 2u, 4u, 8u, ThreadPool::default_size()}) {
+            ThreadPool pool(threads - 1);
+            secs = best_of(reps, [&]() {
+                sink = parallel_sum(nums.data(), n, pool, impl);
+            });
+
+            if (sink != expected) {
+                std::cerr << "Wrong result\n";
+                return 1;
+            }
+            std::cout << "parallel_sum_" << name << "," << threads << "," << n << "," << secs << "," << gb / secs << "\n";
+        }
+    }
+
+    return 0;
+}
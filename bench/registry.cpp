@@ -0,0 +1,79 @@
+/*
+ * Cost of the attendance report (count the enrolled, present and absent
+ * students) of a list with all the ids in [0, N) enrolled and half of
+ * them present:
+ *
+ *  - map:   std::map<int, bool> and std::count_if, like Attendance::print
+ *           of 13_fixme.cpp (only up to 10M ids: it takes ~48 bytes per id)
+ *  - dense: DenseRegistry (libs/dense_registry.h), one row per popcount
+ *           implementation that the CPU supports
+ *
+ * We report the milliseconds of one report and the bytes per id.
+ *
+ * Usage:
+ *   ./bench/registry.exe [ids] [repetitions]
+ * */
+#include <iostream>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include "../libs/dense_registry.h"
+
+template<class F>
+double measure_ms(F f, int reps) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; ++i) {
+        f();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count() / reps;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t ids = argc > 1 ? atol(argv[1]) : 100000000;
+    const int reps = argc > 2 ? atoi(argv[2]) : 10;
+
+    std::cout << "registry,ids,ms_per_report,bytes_per_id\n";
+
+    if (ids <= 10000000) {
+        std::map<int, bool> list;
+        for (size_t id = 0; id < ids; ++id) {
+            list[id] = id % 2;
+        }
+
+        volatile size_t sink = 0;
+        double ms = measure_ms([&]() {
+            size_t present = std::count_if(list.begin(), list.end(), [](auto const& pair) {
+                return pair.second == true;
+            });
+            const size_t absent = list.size() - present;
+            sink = list.size();
+            sink = present;
+            sink = absent;
+        }, reps);
+        // A node of std::map<int, bool>: 3 pointers, the color and the pair
+        std::cout << "map," << ids << "," << ms << "," << 48 << "\n";
+    }
+
+    DenseRegistry list(ids);
+    for (size_t id = 0; id < ids; ++id) {
+        list.enroll(id);
+        if (id % 2) {
+            list.mark_present(id);
+        }
+    }
+
+    for (PopcountImpl impl : supported_popcount_impls()) {
+        volatile size_t sink = 0;
+        double ms = measure_ms([&]() {
+            sink = list.enrolled_count(impl);
+            sink = list.present_count(impl);
+            sink = list.absent_count(impl);
+        }, reps);
+        std::cout << "dense_" << popcount_impl_name(impl) << "," << ids << "," << ms << "," << 0.25 << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Count the primes below N:
+ *
+ *  - trial:  IsPrime::run of 01_is_prime_sequential.cpp (division by all
+ *            the numbers up to sqrt(n), not up to n, or it would never
+ *            finish) for each number; only up to 10M
+ *  - sieve:  PrimeSieve (libs/sieve.h) with 1, 2, 4, ... threads (the
+ *            caller plus threads - 1 in the pool)
+ *  - count:  count_primes (libs/sieve.h), the sieve without keeping it
+ *
+ * We report the milliseconds and the count of primes found.
+ *
+ * Usage:
+ *   ./bench/sieve.exe [N] [max threads]
+ * */
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+
+#include "../libs/sieve.h"
+
+template<class F>
+void measure(const std::string& name, unsigned int threads, uint64_t n, F f) {
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t primes = f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+
+    std::cout << name << "," << threads << "," << n << "," << primes << "," << elapsed.count() << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t n = argc > 1 ? atoll(argv[1]) : 1000000000;
+    const unsigned int max_threads = argc > 2 ? atoi(argv[2]) : ThreadPool::default_size();
+
+    std::cout << "algorithm,threads,n,primes,ms\n";
+
+    if (n <= 10000000) {
+        measure("trial", 1, n, [n]() {
+            uint64_t cnt = 0;
+            for (uint64_t x = 2; x < n; ++x) {
+                bool prime = true;
+                for (uint64_t i = 2; i * i <= x; ++i) {
+                    if (x % i == 0) {
+                        prime = false;
+                        break;
+                    }
+                }
+                cnt += prime;
+            }
+            return cnt;
+        });
+    }
+
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        ThreadPool pool(threads - 1);
+        measure("sieve", threads, n, [n, &pool]() {
+            PrimeSieve sieve(n - 1, pool);
+            return sieve.count_primes(0, n);
+        });
+        measure("count", threads, n, [n, &pool]() {
+            return count_primes(0, n, pool);
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,392 @@
+#ifndef ACTOR_H_
+#define ACTOR_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+
+#include "thread.h"
+#include "queue.h"
+#include "cache_line.h"
+
+/*
+ * Bounded Multiproducer/Multiconsumer lock-free queue.
+ *
+ * This is the classic array based queue of Dmitry Vyukov: each cell
+ * has a sequence number that says if the cell is ready to be written
+ * (seq == pos) or to be read (seq == pos + 1). Producers and consumers
+ * claim a position with a CAS and never wait for each other except
+ * when the queue is full or empty.
+ *
+ * The capacity is rounded up to a power of 2.
+ *
+ * There is no blocking version of push() / pop(): the Actor builds
+ * the blocking (backpressure) on top of try_push().
+ * */
+template<typename T>
+class BoundedMailbox {
+    private:
+        struct Cell {
+            std::atomic<size_t> seq;
+            T data;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        const size_t mask;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos;
+
+        static size_t round_up_pow2(size_t n) {
+            size_t p = 2;
+            while (p < n) {
+                p <<= 1;
+            }
+            return p;
+        }
+
+    public:
+        explicit BoundedMailbox(size_t capacity) :
+            cells(new Cell[round_up_pow2(capacity)]),
+            mask(round_up_pow2(capacity) - 1),
+            enqueue_pos(0), dequeue_pos(0) {
+            for (size_t i = 0; i <= mask; ++i) {
+                cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        size_t capacity() const {
+            return mask + 1;
+        }
+
+        bool try_push(T const& val) {
+            size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            while (true) {
+                Cell& cell = cells[pos & mask];
+                const size_t seq = cell.seq.load(std::memory_order_acquire);
+                const intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+                if (dif == 0) {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.data = val;
+                        cell.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (dif < 0) {
+                    return false; // full
+                } else {
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool try_pop(T& val) {
+            size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            while (true) {
+                Cell& cell = cells[pos & mask];
+                const size_t seq = cell.seq.load(std::memory_order_acquire);
+                const intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+
+                if (dif == 0) {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        val = std::move(cell.data);
+                        cell.seq.store(pos + mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (dif < 0) {
+                    return false; // empty
+                } else {
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Approximated: other threads may be pushing or popping
+        bool empty() const {
+            return dequeue_pos.load() >= enqueue_pos.load();
+        }
+
+        BoundedMailbox(const BoundedMailbox&) = delete;
+        BoundedMailbox& operator=(const BoundedMailbox&) = delete;
+};
+
+class ActorPool;
+
+/*
+ * What the ActorPool knows about an actor: it can be scheduled
+ * and it can process a batch of its messages.
+ * */
+class ActorBase {
+    private:
+        friend class ActorPool;
+        friend class ActorWorker;
+
+        // True while the actor is in the run queue of the pool or
+        // while a worker is processing its messages. This flag is what
+        // guarantees that an actor runs in one worker at a time.
+        std::atomic<bool> scheduled;
+
+    protected:
+        ActorPool& pool;
+
+        inline void schedule();
+
+        // Called by the destructor of the subclass: after this the pool
+        // does not look at the actor anymore
+        inline void unregister();
+
+        // Process up to max_cnt messages; return how many were processed
+        virtual size_t drain(size_t max_cnt) = 0;
+        virtual bool has_messages() const = 0;
+
+    public:
+        inline explicit ActorBase(ActorPool& pool);
+
+        bool is_idle() const {
+            return not scheduled and not has_messages();
+        }
+
+        inline virtual ~ActorBase();
+
+        ActorBase(const ActorBase&) = delete;
+        ActorBase& operator=(const ActorBase&) = delete;
+};
+
+/*
+ * Worker of the ActorPool: it pops an actor from the run queue
+ * and processes a batch of its messages.
+ * */
+class ActorWorker : public Thread {
+    private:
+        Queue<ActorBase*>& runnable;
+        const size_t batch_size;
+
+    public:
+        ActorWorker(Queue<ActorBase*>& runnable, size_t batch_size) :
+            runnable(runnable), batch_size(batch_size) {}
+
+        virtual void run() override {
+            while (true) {
+                ActorBase *actor;
+                try {
+                    actor = runnable.pop();
+                } catch (const ClosedQueue&) {
+                    break;
+                }
+
+                const size_t processed = actor->drain(batch_size);
+
+                // The batch was consumed completely: there may be more
+                // messages so we put the actor at the end of the run queue
+                // (other actors deserve their chance too)
+                if (processed == batch_size) {
+                    runnable.push(actor);
+                    continue;
+                }
+
+                // Unschedule and check again: a sender may had pushed a
+                // message after our last try_pop() but before we cleared
+                // the flag; it saw "scheduled" and didn't schedule us.
+                actor->scheduled = false;
+                if (actor->has_messages() and not actor->scheduled.exchange(true)) {
+                    runnable.push(actor);
+                }
+            }
+        }
+};
+
+/*
+ * Shared pool of threads that run the actors.
+ *
+ * Thousands of actors can share a few threads: an actor uses a thread
+ * only while it has messages to process.
+ * */
+class ActorPool {
+    private:
+        friend class ActorBase;
+
+        Queue<ActorBase*> runnable;
+        std::vector<Thread*> workers;
+
+        std::mutex mtx;
+        std::vector<ActorBase*> actors;
+
+        void enqueue(ActorBase *actor) {
+            runnable.push(actor);
+        }
+
+        void add(ActorBase *actor) {
+            std::unique_lock<std::mutex> lck(mtx);
+            actors.push_back(actor);
+        }
+
+        void remove(ActorBase *actor) {
+            std::unique_lock<std::mutex> lck(mtx);
+            actors.erase(std::remove(actors.begin(), actors.end(), actor), actors.end());
+        }
+
+    public:
+        static const size_t DEFAULT_BATCH_SIZE = 64;
+
+        explicit ActorPool(unsigned int workers_cnt = std::thread::hardware_concurrency(),
+                           size_t batch_size = DEFAULT_BATCH_SIZE) :
+            runnable(UINT_MAX-1) {
+            if (workers_cnt == 0) {
+                workers_cnt = 1;
+            }
+
+            for (unsigned int i = 0; i < workers_cnt; ++i) {
+                Thread *t = new ActorWorker(runnable, batch_size);
+                workers.push_back(t);
+                t->start();
+            }
+        }
+
+        // Wait until all the actors processed all their messages
+        //
+        // Note: if the actors keep sending messages to each other
+        // forever this will never return.
+        void wait_idle() {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lck(mtx);
+                    bool all_idle = std::all_of(actors.begin(), actors.end(),
+                            [](const ActorBase *a) { return a->is_idle(); });
+                    if (all_idle) {
+                        return;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+
+        ~ActorPool() {
+            wait_idle();
+
+            runnable.close();
+            for (Thread *t : workers) {
+                t->join();
+                delete t;
+            }
+        }
+
+        ActorPool(const ActorPool&) = delete;
+        ActorPool& operator=(const ActorPool&) = delete;
+};
+
+ActorBase::ActorBase(ActorPool& pool) : scheduled(false), pool(pool) {
+    pool.add(this);
+}
+
+ActorBase::~ActorBase() {
+    unregister();
+}
+
+void ActorBase::unregister() {
+    pool.remove(this);
+}
+
+void ActorBase::schedule() {
+    if (not scheduled.exchange(true)) {
+        pool.enqueue(this);
+    }
+}
+
+/*
+ * An actor is an active object that does not own a thread: it owns a
+ * bounded mailbox and the pool runs receive() for each message, one
+ * message at a time.
+ *
+ * Because an actor never processes two messages concurrently,
+ * receive() can modify the state of the actor *without locks*: the
+ * state is never shared, only the messages are.
+ *
+ * This is the second solution of 13_fixme.cpp (pass the list through
+ * a queue) without the hand-rolled Thread + Queue:
+ *
+ *      class AttendanceActor : public Actor<int> {
+ *          Attendance list;
+ *          void receive(const int& student_id) override {
+ *              if (not list.is_student_in_list(student_id))
+ *                  list.add_student_to_list(student_id);
+ *              list.mark_attendance_of_student(student_id);
+ *          }
+ *      };
+ *
+ * send() applies backpressure: if the mailbox is full the sender waits
+ * until there is room. Be careful when an actor sends to another actor
+ * with send(): if they send to each other and both mailboxes are full
+ * they will deadlock. Use try_send() in that case.
+ *
+ * Destroy an actor only when it is idle (see ActorPool::wait_idle())
+ * */
+template<typename Msg>
+class Actor : public ActorBase {
+    private:
+        BoundedMailbox<Msg> mailbox;
+
+        size_t drain(size_t max_cnt) override {
+            Msg msg;
+            size_t cnt = 0;
+            while (cnt < max_cnt and mailbox.try_pop(msg)) {
+                try {
+                    this->receive(msg);
+                } catch(const std::exception &err) {
+                    std::cerr << "Unexpected exception: " << err.what() << "\n";
+                } catch(...) {
+                    std::cerr << "Unexpected exception: <unknown>\n";
+                }
+                ++cnt;
+            }
+            return cnt;
+        }
+
+        bool has_messages() const override {
+            return not mailbox.empty();
+        }
+
+    public:
+        static const size_t DEFAULT_MAILBOX_SIZE = 1024;
+
+        explicit Actor(ActorPool& pool, size_t mailbox_size = DEFAULT_MAILBOX_SIZE) :
+            ActorBase(pool), mailbox(mailbox_size) {}
+
+        // Return false if the mailbox is full
+        bool try_send(Msg const& msg) {
+            if (not mailbox.try_push(msg)) {
+                return false;
+            }
+            schedule();
+            return true;
+        }
+
+        // Block until the message fits in the mailbox
+        void send(Msg const& msg) {
+            unsigned int attempts = 0;
+            while (not mailbox.try_push(msg)) {
+                if (++attempts < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+            schedule();
+        }
+
+        virtual void receive(Msg const& msg) = 0;
+
+        ~Actor() {
+            // ActorPool::wait_idle() calls has_messages(): we must leave
+            // the pool before the mailbox is destroyed
+            unregister();
+        }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef ATOMIC_OPS_H_
+#define ATOMIC_OPS_H_
+
+#include <atomic>
+#include <optional>
+
+/*
+ * Lock-free conditional updates of a std::atomic.
+ *
+ * The fix of 08_monitor_interface_critical_section.cpp is a monitor
+ * with the "check and increment" critical section:
+ *
+ *      void inc_if_you_are_zero(unsigned int s) {
+ *          std::unique_lock<std::mutex> lck(m);
+ *          if (result == 0) {
+ *              result += s;
+ *          }
+ *      }
+ *
+ * When the state is a single integer, the CPU can do the "check and
+ * update" atomically for us with a compare-and-swap (CAS): "write
+ * the new value *only if* the current value is still the one that
+ * I read". If another thread changed it in the middle, the CAS fails
+ * and we retry with the fresh value:
+ *
+ *      update_if(result,
+ *                [](unsigned int v) { return v == 0; },
+ *                [s](unsigned int v) { return v + s; });
+ *
+ * No thread ever blocks: a reader (load()) never waits and a writer
+ * only retries if another writer won the race.
+ *
+ * These functions work for any std::atomic<T>; they make sense for the
+ * T that are lock-free (std::atomic<T>::is_always_lock_free).
+ * */
+
+/*
+ * Read the current value v and replace it with f(v) atomically.
+ * If f returns std::nullopt, nothing is written.
+ *
+ * Return the value that was replaced or std::nullopt if f
+ * refused to update.
+ *
+ * f may be called more than once (once per retry): it must not
+ * have side effects.
+ * */
+template<typename T, class F>
+std::optional<T> fetch_update(std::atomic<T>& a, F f) {
+    T current = a.load(std::memory_order_relaxed);
+    while (true) {
+        std::optional<T> next = f(current);
+        if (not next) {
+            return std::nullopt;
+        }
+
+        // On failure, compare_exchange_weak loads the fresh value
+        // in current and we retry. The weak version may fail
+        // spuriously but in a loop that's fine and it is cheaper
+        // in some architectures.
+        if (a.compare_exchange_weak(current, *next,
+                                    std::memory_order_acq_rel,
+                                    std::memory_order_relaxed)) {
+            return current;
+        }
+    }
+}
+
+/*
+ * If pred(v) is true, replace the current value v by f(v) atomically.
+ * Return true if the value was updated.
+ * */
+template<typename T, class Pred, class F>
+bool update_if(std::atomic<T>& a, Pred pred, F f) {
+    return fetch_update(a, [&pred, &f](T v) -> std::optional<T> {
+        if (not pred(v)) {
+            return std::nullopt;
+        }
+        return f(v);
+    }).has_value();
+}
+
+/*
+ * A value that can be set only once.
+ *
+ * The first set() wins and the others fail. Readers never block:
+ * is_set() is an atomic load and try_get() is that load plus a copy.
+ *
+ * The value itself is a plain member: it is written once, before the
+ * release store of SET, and it must be read only after an acquire load
+ * that saw SET (try_get() does exactly that). Reading it any other way
+ * races with set().
+ *
+ * Useful for "the first thread that finds the answer publishes it"
+ * like AreAnyPrime in 08_monitor_interface_critical_section.cpp
+ * */
+template<typename T>
+class SetOnceLatch {
+    private:
+        enum { UNSET, SETTING, SET };
+
+        std::atomic<int> state;
+        T value;
+
+    public:
+        SetOnceLatch() : state(UNSET), value() {}
+
+        // Return true if this call set the value
+        bool set(const T& v) {
+            int expected = UNSET;
+            if (not state.compare_exchange_strong(expected, SETTING,
+                                                 std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                return false;
+            }
+
+            value = v;
+            state.store(SET, std::memory_order_release);
+            return true;
+        }
+
+        // A concurrent set() that is still writing the value is
+        // considered "not set yet"
+        bool is_set() const {
+            return state.load(std::memory_order_acquire) == SET;
+        }
+
+        // Return true and copy the value in v if it was set. The copy
+        // happens after the acquire load of is_set(): the write of
+        // value in set() is visible by then
+        bool try_get(T& v) const {
+            if (not is_set()) {
+                return false;
+            }
+            v = value;
+            return true;
+        }
+
+        SetOnceLatch(const SetOnceLatch&) = delete;
+        SetOnceLatch& operator=(const SetOnceLatch&) = delete;
+};
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef BATCH_PRIMES_H_
+#define BATCH_PRIMES_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#include "cpu_features.h"
+#include "prime_table.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Primality of many 32 bits numbers at once, by trial division.
+ *
+ * IsPrime of 01..03 checks one number at a time with a % per divisor.
+ * Here the same divisor is tried against 8 (AVX2) or 16 (AVX-512)
+ * numbers at the same time, one per lane of a vector register:
+ *
+ *  - only the primes up to sqrt(2^32) are tried as divisors, taken
+ *    from the compile time table of prime_table.h (6542 primes instead
+ *    of the 17477 numbers of a wheel-30)
+ *  - n % d == 0 is replaced by a multiplication: for an odd d with
+ *    inverse d' (d * d' = 1 mod 2^32), d divides n if and only if
+ *    n * d' mod 2^32 <= (2^32 - 1) / d (Granlund and Montgomery).
+ *    Vector units have no integer division but they multiply well
+ *  - a lane is done when d divides its number (composite) or when
+ *    d * d goes beyond it (prime); the whole batch stops when all
+ *    the lanes are done (see two_passes() for how we keep the lanes
+ *    busy)
+ *
+ * The result is a bitmap: the bit i is set if nums[i] is a prime.
+ *
+ *      std::vector<uint64_t> primes = is_prime_batch(nums, N);
+ *
+ * The lanes wait for the slowest one (the largest prime of the batch)
+ * so this shines with many mid-sized numbers; for a single large
+ * number use is_prime_fast (miller_rabin.h).
+ * */
+enum class TrialDivisionImpl {
+    GENERIC,
+    AVX2,
+    AVX512
+};
+
+namespace batch_primes_detail {
+    // The largest d with d * d < 2^32
+    const uint32_t MAX_DIVISOR = 65535;
+
+    /*
+     * Call f(d) for each divisor to try, in order: the odd primes of the
+     * prime table up to MAX_DIVISOR and, if the table is smaller than
+     * that, the numbers coprime with 30 from the table's bound on
+     * ("wheel-30").
+     * */
+    template<class F>
+    constexpr void for_each_divisor(F f) {
+        for (const uint32_t *p = PrimeTable::begin() + 1; p != PrimeTable::end() and *p <= MAX_DIVISOR; ++p) {
+            f(*p);
+        }
+        for (uint32_t d = PrimeTable::bound; d <= MAX_DIVISOR; ++d) {
+            if (d % 2 and d % 3 and d % 5) {
+                f(d);
+            }
+        }
+    }
+
+    constexpr size_t count_divisors() {
+        size_t cnt = 0;
+        for_each_divisor([&cnt](uint32_t) { ++cnt; });
+        return cnt;
+    }
+
+    const size_t DIVISORS_CNT = count_divisors();
+
+    // The divisors, as structure of arrays so a vector load takes
+    // the same field of consecutive divisors
+    struct Divisors {
+        uint32_t square[DIVISORS_CNT];   // d * d
+        uint32_t inverse[DIVISORS_CNT];  // d^-1 mod 2^32
+        uint32_t limit[DIVISORS_CNT];    // (2^32 - 1) / d
+
+        static constexpr size_t size() {
+            return DIVISORS_CNT;
+        }
+    };
+
+    constexpr Divisors make_divisors() {
+        Divisors divs{};
+        size_t i = 0;
+        for_each_divisor([&divs, &i](uint32_t d) {
+            uint32_t inv = d;
+            for (int k = 0; k < 4; ++k) {
+                inv *= 2 - d * inv;
+            }
+            divs.square[i] = d * d;
+            divs.inverse[i] = inv;
+            divs.limit[i] = UINT32_MAX / d;
+            ++i;
+        });
+        return divs;
+    }
+
+    // Computed by the compiler, like the prime table: no startup cost
+    inline constexpr Divisors DIVISORS = make_divisors();
+
+    inline bool is_prime_generic(uint32_t n) {
+        if (PrimeTable::contains(n)) {
+            return PrimeTable::is_prime(n);
+        }
+        if (n % 2 == 0) {
+            return false;
+        }
+
+        const Divisors& divs = DIVISORS;
+        for (size_t i = 0; i < divs.size(); ++i) {
+            if (divs.square[i] > n) {
+                return true;
+            }
+            if (n * divs.inverse[i] <= divs.limit[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline void batch_generic(const unsigned int *nums, size_t cnt, uint64_t *bitmap) {
+        for (size_t i = 0; i < cnt; ++i) {
+            if (is_prime_generic(nums[i])) {
+                bitmap[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+
+    /*
+     * The lanes of a batch wait for the slowest one so mixing primes
+     * (that need all the divisors up to sqrt(n)) with composites (most
+     * of them have a small factor) wastes most of the lanes. So we go
+     * in two passes:
+     *
+     *  - all the numbers against the first FIRST_PASS_DIVISORS divisors:
+     *    this decides ~90% of the random numbers in a few iterations
+     *  - the survivors (mostly primes) are packed together and run
+     *    against the rest of the divisors: now most of the lanes of a
+     *    batch need the same number of iterations
+     *
+     * kernel(lanes, k0, k1, composite, active) runs the divisors
+     * [k0, k1) against W lanes and returns two masks of lanes: the
+     * composites and the undecided ones.
+     * */
+    const size_t FIRST_PASS_DIVISORS = 64;
+
+    template<size_t W, class Kernel>
+    void two_passes(const unsigned int *nums, size_t cnt, uint64_t *bitmap, Kernel kernel) {
+        const Divisors& divs = DIVISORS;
+        const size_t first = std::min(FIRST_PASS_DIVISORS, divs.size());
+
+        std::vector<size_t> survivors;
+        alignas(64) uint32_t lanes[W];
+
+        for (size_t i = 0; i < cnt; i += W) {
+            const size_t used = std::min(cnt - i, W);
+            // The last batch is padded with zeros (not primes)
+            std::fill(std::copy(nums + i, nums + i + used, lanes), lanes + W, 0);
+
+            uint32_t composite, active;
+            kernel(lanes, 0, first, composite, active);
+
+            for (size_t l = 0; l < used; ++l) {
+                if (active & (1u << l)) {
+                    survivors.push_back(i + l);
+                } else if (not (composite & (1u << l))) {
+                    bitmap[(i + l) / 64] |= uint64_t(1) << ((i + l) % 64);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < survivors.size(); i += W) {
+            const size_t used = std::min(survivors.size() - i, W);
+            std::fill(lanes, lanes + W, 0);
+            for (size_t l = 0; l < used; ++l) {
+                lanes[l] = nums[survivors[i + l]];
+            }
+
+            uint32_t composite, active;
+            kernel(lanes, first, divs.size(), composite, active);
+
+            // The lanes still active ran out of divisors: primes
+            for (size_t l = 0; l < used; ++l) {
+                if (not (composite & (1u << l))) {
+                    const size_t idx = survivors[i + l];
+                    bitmap[idx / 64] |= uint64_t(1) << (idx % 64);
+                }
+            }
+        }
+    }
+
+#if defined(__x86_64__)
+    /*
+     * The kernels check if all the lanes are done once per block of
+     * UNROLL divisors, not after each one: that check depends on the
+     * result of the previous divisor, so checking it each time chains
+     * all the divisors one after the other (each one waits for the
+     * multiplication of the previous one). Within a block the divisors
+     * are independent and only their "found" masks are or-ed.
+     *
+     * A block may go past the divisor that decided a lane; that is fine
+     * because the squares grow: once d * d > n it stays so for the rest
+     * of the block and those divisors never count as found.
+     * */
+    const size_t UNROLL = 8;
+
+    // The lanes of n with d * d <= n
+    __attribute__((target("avx2")))
+    inline __m256i square_le_avx2(__m256i n, size_t k) {
+        const __m256i sq = _mm256_set1_epi32(DIVISORS.square[k]);
+        return _mm256_cmpeq_epi32(_mm256_max_epu32(sq, n), n);
+    }
+
+    // The lanes of n with d * d <= n and d dividing n
+    __attribute__((target("avx2")))
+    inline __m256i found_avx2(__m256i n, size_t k) {
+        const __m256i inv = _mm256_set1_epi32(DIVISORS.inverse[k]);
+        const __m256i lim = _mm256_set1_epi32(DIVISORS.limit[k]);
+
+        // n * d^-1 <= limit: d divides n
+        const __m256i prod = _mm256_mullo_epi32(n, inv);
+        const __m256i divisible = _mm256_cmpeq_epi32(_mm256_max_epu32(prod, lim), lim);
+        return _mm256_and_si256(divisible, square_le_avx2(n, k));
+    }
+
+    __attribute__((target("avx2")))
+    inline void kernel_avx2(const uint32_t *lanes, size_t k0, size_t k1,
+                            uint32_t& composite_mask, uint32_t& active_mask) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i two = _mm256_set1_epi32(2);
+
+        const __m256i n = _mm256_load_si256((const __m256i*)lanes);
+
+        // n <= 1 or even: decided. Prime only if n == 2.
+        const __m256i small = _mm256_cmpeq_epi32(_mm256_max_epu32(n, one), one);
+        const __m256i even = _mm256_cmpeq_epi32(_mm256_and_si256(n, one), zero);
+        const __m256i is_two = _mm256_cmpeq_epi32(n, two);
+
+        __m256i composite = _mm256_andnot_si256(is_two, _mm256_or_si256(small, even));
+        __m256i active = _mm256_andnot_si256(_mm256_or_si256(small, even), _mm256_set1_epi32(-1));
+
+        size_t k = k0;
+        while (k < k1 and not _mm256_testz_si256(active, active)) {
+            const size_t block = std::min(UNROLL, k1 - k);
+
+            // Two independent chains of or-s
+            __m256i found0 = zero, found1 = zero;
+            if (block == UNROLL) {
+                for (size_t j = 0; j < UNROLL; j += 2) {
+                    found0 = _mm256_or_si256(found0, found_avx2(n, k + j));
+                    found1 = _mm256_or_si256(found1, found_avx2(n, k + j + 1));
+                }
+            } else {
+                for (size_t j = 0; j < block; ++j) {
+                    found0 = _mm256_or_si256(found0, found_avx2(n, k + j));
+                }
+            }
+            const __m256i found = _mm256_and_si256(active, _mm256_or_si256(found0, found1));
+
+            // Still active: nothing found and the last d * d <= n
+            composite = _mm256_or_si256(composite, found);
+            active = _mm256_andnot_si256(found, _mm256_and_si256(active, square_le_avx2(n, k + block - 1)));
+            k += block;
+        }
+
+        composite_mask = _mm256_movemask_ps(_mm256_castsi256_ps(composite));
+        active_mask = _mm256_movemask_ps(_mm256_castsi256_ps(active));
+    }
+
+    __attribute__((target("avx512f")))
+    inline __mmask16 found_avx512(__m512i n, size_t k) {
+        const __m512i sq = _mm512_set1_epi32(DIVISORS.square[k]);
+        const __m512i inv = _mm512_set1_epi32(DIVISORS.inverse[k]);
+        const __m512i lim = _mm512_set1_epi32(DIVISORS.limit[k]);
+
+        const __mmask16 sq_le_n = _mm512_cmple_epu32_mask(sq, n);
+        const __m512i prod = _mm512_mullo_epi32(n, inv);
+        return _mm512_mask_cmple_epu32_mask(sq_le_n, prod, lim);
+    }
+
+    __attribute__((target("avx512f")))
+    inline void kernel_avx512(const uint32_t *lanes, size_t k0, size_t k1,
+                              uint32_t& composite_mask, uint32_t& active_mask) {
+        const __m512i one = _mm512_set1_epi32(1);
+        const __m512i two = _mm512_set1_epi32(2);
+
+        const __m512i n = _mm512_load_si512((const void*)lanes);
+
+        const __mmask16 small = _mm512_cmple_epu32_mask(n, one);
+        const __mmask16 even = _mm512_testn_epi32_mask(n, one);
+        const __mmask16 is_two = _mm512_cmpeq_epi32_mask(n, two);
+
+        __mmask16 composite = (small | even) & ~is_two;
+        __mmask16 active = ~(small | even);
+
+        size_t k = k0;
+        while (k < k1 and active) {
+            const size_t block = std::min(UNROLL, k1 - k);
+
+            __mmask16 found0 = 0, found1 = 0;
+            if (block == UNROLL) {
+                for (size_t j = 0; j < UNROLL; j += 2) {
+                    found0 |= found_avx512(n, k + j);
+                    found1 |= found_avx512(n, k + j + 1);
+                }
+            } else {
+                for (size_t j = 0; j < block; ++j) {
+                    found0 |= found_avx512(n, k + j);
+                }
+            }
+            const __mmask16 found = active & (found0 | found1);
+
+            const __m512i last_sq = _mm512_set1_epi32(DIVISORS.square[k + block - 1]);
+            composite |= found;
+            active = _mm512_mask_cmple_epu32_mask(active & ~found, last_sq, n);
+            k += block;
+        }
+
+        composite_mask = composite;
+        active_mask = active;
+    }
+#endif
+}
+
+// The best implementation supported by this CPU
+inline TrialDivisionImpl best_trial_division_impl() {
+    const CpuFeatures& cpu = CpuFeatures::get();
+    if (cpu.avx512f) return TrialDivisionImpl::AVX512;
+    if (cpu.avx2) return TrialDivisionImpl::AVX2;
+    return TrialDivisionImpl::GENERIC;
+}
+
+// All the implementations that this CPU can run (for tests and benchmarks)
+inline std::vector<TrialDivisionImpl> supported_trial_division_impls() {
+    const CpuFeatures& cpu = CpuFeatures::get();
+    std::vector<TrialDivisionImpl> impls = {TrialDivisionImpl::GENERIC};
+    if (cpu.avx2) impls.push_back(TrialDivisionImpl::AVX2);
+    if (cpu.avx512f) impls.push_back(TrialDivisionImpl::AVX512);
+    return impls;
+}
+
+inline const char* trial_division_impl_name(TrialDivisionImpl impl) {
+    switch (impl) {
+        case TrialDivisionImpl::AVX512: return "avx512";
+        case TrialDivisionImpl::AVX2: return "avx2";
+        default: return "generic";
+    }
+}
+
+/*
+ * Set the bit i of bitmap if nums[i] is a prime, for i in [0, cnt).
+ * The bitmap must have room for (cnt + 63) / 64 words; its bits are
+ * overwritten.
+ * */
+inline void is_prime_batch(const unsigned int *nums, size_t cnt, uint64_t *bitmap,
+                           TrialDivisionImpl impl = best_trial_division_impl()) {
+    using namespace batch_primes_detail;
+
+    std::fill(bitmap, bitmap + (cnt + 63) / 64, 0);
+
+    switch (impl) {
+#if defined(__x86_64__)
+        case TrialDivisionImpl::AVX512:
+            two_passes<16>(nums, cnt, bitmap, kernel_avx512);
+            break;
+        case TrialDivisionImpl::AVX2:
+            two_passes<8>(nums, cnt, bitmap, kernel_avx2);
+            break;
+#endif
+        default:
+            batch_generic(nums, cnt, bitmap);
+    }
+}
+
+inline std::vector<uint64_t> is_prime_batch(const unsigned int *nums, size_t cnt,
+                                            TrialDivisionImpl impl = best_trial_division_impl()) {
+    std::vector<uint64_t> bitmap((cnt + 63) / 64);
+    is_prime_batch(nums, cnt, bitmap.data(), impl);
+    return bitmap;
+}
+
+#endif
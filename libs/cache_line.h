@@ -0,0 +1,85 @@
+#ifndef CACHE_LINE_H_
+#define CACHE_LINE_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/*
+ * Size of a cache line in the CPUs that we care about (x86-64 and most
+ * of the ARMs).
+ *
+ * C++17 has std::hardware_destructive_interference_size for this but
+ * g++ warns about using it in headers (its value may change between
+ * compiler flags) so we hardcode it.
+ * */
+#define CACHE_LINE_SIZE 64
+
+/*
+ * A T alone in its own cache line(s).
+ *
+ * Two threads that write to two different variables that happen to be
+ * in the same cache line will fight for it as if they were writing to
+ * the same variable: this is called "false sharing".
+ *
+ * Putting each variable in a CacheAligned avoids that, at the cost
+ * of some memory.
+ * */
+template<typename T>
+struct alignas(CACHE_LINE_SIZE) CacheAligned {
+    T value;
+
+    CacheAligned() : value() {}
+    explicit CacheAligned(const T& value) : value(value) {}
+};
+
+/*
+ * How many T fit in a cache line (at least 1).
+ * */
+template<typename T>
+constexpr size_t per_cache_line() {
+    return sizeof(T) >= CACHE_LINE_SIZE ? 1 : CACHE_LINE_SIZE / sizeof(T);
+}
+
+/*
+ * An allocator that puts the first element at the start of a cache line.
+ *
+ * CacheAligned wastes a whole line per element; for an array written
+ * by many threads it is enough that each thread writes a range of
+ * elements that starts and ends at a cache line boundary:
+ *
+ *      CacheAlignedVector<char> results(N);
+ *      // thread k writes [k * g, (k+1) * g) with g a multiple
+ *      // of per_cache_line<char>(): no line is shared
+ *
+ * Compare with the bool results[N] of 02/03: N adjacent bools in the
+ * same line written by N threads.
+ * */
+template<typename T>
+struct CacheAlignedAllocator {
+    typedef T value_type;
+
+    CacheAlignedAllocator() = default;
+
+    template<typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(CACHE_LINE_SIZE)));
+    }
+
+    void deallocate(T *p, size_t) {
+        ::operator delete(p, std::align_val_t(CACHE_LINE_SIZE));
+    }
+
+    template<typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+
+    template<typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using CacheAlignedVector = std::vector<T, CacheAlignedAllocator<T> >;
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef CONCURRENT_MAP_H_
+#define CONCURRENT_MAP_H_
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <stdexcept>
+
+#include "cache_line.h"
+#include "int_math.h"
+
+/*
+ * Concurrent hash map with lock striping.
+ *
+ * The map is split in shards, each one with its own mutex. Two threads
+ * that work on keys of different shards do not contend; with enough
+ * shards (several per core) most of the operations do not contend at all.
+ *
+ * Each shard is an open addressing hash table with linear probing:
+ * the entries are in a plain array so a lookup is a hash and one
+ * or two cache misses, not a walk over the nodes of a tree (std::map)
+ * or of a list (std::unordered_map).
+ *
+ * The operations are critical sections by themselves. In particular the
+ * "add the student if it is not in the list, then mark it" sequence of
+ * 13_fixme.cpp is a single atomic call:
+ *
+ *      ConcurrentMap<int, bool> list;
+ *      list.upsert(id, false, [](bool& present) { present = true; });
+ *
+ * for_each() visits the shards one at a time, locking only the shard
+ * that it is visiting: it never stops the whole map but the view is not
+ * a snapshot (changes in the shards not visited yet will be seen).
+ *
+ * K and V must be default constructible and copyable. The callables
+ * run with the lock of the shard taken: they must be short and they
+ * must not call the map.
+ * */
+template<typename K, typename V, class Hash = std::hash<K> >
+class ConcurrentMap {
+    private:
+        class Table {
+            private:
+                // Key, value and state together: a probe touches a
+                // single cache line most of the times
+                struct Entry {
+                    K key;
+                    V value;
+                    bool used;
+
+                    Entry() : key(), value(), used(false) {}
+                };
+
+                std::vector<Entry> entries;
+                size_t mask;
+                size_t count;
+
+                void grow() {
+                    std::vector<Entry> old;
+                    old.swap(entries);
+
+                    entries.resize(old.size() * 2);
+                    mask = entries.size() - 1;
+                    count = 0;
+
+                    for (const Entry& e : old) {
+                        if (e.used) {
+                            place(find_free_slot(e.key), e.key, e.value);
+                        }
+                    }
+                }
+
+                size_t ideal_slot(const K& key) const {
+                    return mix_hash(Hash()(key)) & mask;
+                }
+
+                size_t find_free_slot(const K& key) const {
+                    size_t i = ideal_slot(key);
+                    while (entries[i].used) {
+                        i = (i + 1) & mask;
+                    }
+                    return i;
+                }
+
+                void place(size_t slot, const K& key, const V& value) {
+                    entries[slot].key = key;
+                    entries[slot].value = value;
+                    entries[slot].used = true;
+                    ++count;
+                }
+
+            public:
+                Table() : entries(16), mask(15), count(0) {}
+
+                // Return the slot of the key or -1
+                long find(const K& key) const {
+                    size_t i = ideal_slot(key);
+                    while (entries[i].used) {
+                        if (entries[i].key == key) {
+                            return i;
+                        }
+                        i = (i + 1) & mask;
+                    }
+                    return -1;
+                }
+
+                V& value_at(size_t slot) {
+                    return entries[slot].value;
+                }
+
+                const V& value_at(size_t slot) const {
+                    return entries[slot].value;
+                }
+
+                // The key must not be in the table
+                size_t insert(const K& key, const V& value) {
+                    // Keep the load factor under 0.75: linear probing
+                    // degrades fast when the table is almost full
+                    if ((count + 1) * 4 > entries.size() * 3) {
+                        grow();
+                    }
+
+                    size_t slot = find_free_slot(key);
+                    place(slot, key, value);
+                    return slot;
+                }
+
+                bool erase(const K& key) {
+                    long found = find(key);
+                    if (found < 0) {
+                        return false;
+                    }
+
+                    // Backward shift deletion: move back the following
+                    // entries of the cluster that would become unreachable
+                    // through the hole, so we don't need tombstones.
+                    size_t hole = found;
+                    size_t i = (hole + 1) & mask;
+                    while (entries[i].used) {
+                        size_t ideal = ideal_slot(entries[i].key);
+                        // The entry at i can move to the hole only if its
+                        // ideal slot is not in (hole, i] (circularly)
+                        bool in_between = (hole <= i) ?
+                            (hole < ideal and ideal <= i) :
+                            (hole < ideal or ideal <= i);
+                        if (not in_between) {
+                            entries[hole] = entries[i];
+                            hole = i;
+                        }
+                        i = (i + 1) & mask;
+                    }
+
+                    entries[hole] = Entry();
+                    --count;
+                    return true;
+                }
+
+                size_t size() const {
+                    return count;
+                }
+
+                template<class F>
+                void for_each(F& f) const {
+                    for (const Entry& e : entries) {
+                        if (e.used) {
+                            f(e.key, e.value);
+                        }
+                    }
+                }
+        };
+
+        struct alignas(CACHE_LINE_SIZE) Shard {
+            mutable std::mutex mtx;
+            Table table;
+        };
+
+        std::unique_ptr<Shard[]> shards;
+        const unsigned int shard_bits;
+
+        Shard& shard_of(const K& key) const {
+            return shards[mix_hash(Hash()(key)) >> (64 - shard_bits)];
+        }
+
+        // Called from the init list: throw before allocating anything
+        static unsigned int checked_shard_bits(unsigned int shard_bits) {
+            if (shard_bits == 0 or shard_bits > 16) {
+                throw std::runtime_error("The shard bits must be between 1 and 16");
+            }
+            return shard_bits;
+        }
+
+    public:
+        // 2^shard_bits shards (64 by default)
+        explicit ConcurrentMap(unsigned int shard_bits = 6) :
+            shards(new Shard[(size_t)1 << checked_shard_bits(shard_bits)]),
+            shard_bits(shard_bits) {}
+
+        // Return true if the key was inserted, false if it was already there
+        bool insert_if_absent(const K& key, const V& value) {
+            Shard& s = shard_of(key);
+            std::unique_lock<std::mutex> lck(s.mtx);
+
+            if (s.table.find(key) >= 0) {
+                return false;
+            }
+            s.table.insert(key, value);
+            return true;
+        }
+
+        // Call f(value) if the key is present; return false otherwise
+        template<class F>
+        bool update(const K& key, F f) {
+            Shard& s = shard_of(key);
+            std::unique_lock<std::mutex> lck(s.mtx);
+
+            long slot = s.table.find(key);
+            if (slot < 0) {
+                return false;
+            }
+            f(s.table.value_at(slot));
+            return true;
+        }
+
+        // Insert the key with init_value if absent and then call f(value)
+        template<class F>
+        void upsert(const K& key, const V& init_value, F f) {
+            Shard& s = shard_of(key);
+            std::unique_lock<std::mutex> lck(s.mtx);
+
+            long slot = s.table.find(key);
+            if (slot < 0) {
+                slot = s.table.insert(key, init_value);
+            }
+            f(s.table.value_at(slot));
+        }
+
+        // Copy the value in out and return true if the key is present
+        bool find(const K& key, V& out) const {
+            Shard& s = shard_of(key);
+            std::unique_lock<std::mutex> lck(s.mtx);
+
+            long slot = s.table.find(key);
+            if (slot < 0) {
+                return false;
+            }
+            out = s.table.value_at(slot);
+            return true;
+        }
+
+        bool contains(const K& key) const {
+            Shard& s = shard_of(key);
+            std::unique_lock<std::mutex> lck(s.mtx);
+            return s.table.find(key) >= 0;
+        }
+
+        bool erase(const K& key) {
+            Shard& s = shard_of(key);
+            std::unique_lock<std::mutex> lck(s.mtx);
+            return s.table.erase(key);
+        }
+
+        size_t size() const {
+            size_t total = 0;
+            for (size_t i = 0; i < ((size_t)1 << shard_bits); ++i) {
+                std::unique_lock<std::mutex> lck(shards[i].mtx);
+                total += shards[i].table.size();
+            }
+            return total;
+        }
+
+        // Call f(key, value) for each entry, one shard at a time
+        template<class F>
+        void for_each(F f) const {
+            for (size_t i = 0; i < ((size_t)1 << shard_bits); ++i) {
+                std::unique_lock<std::mutex> lck(shards[i].mtx);
+                shards[i].table.for_each(f);
+            }
+        }
+
+        ConcurrentMap(const ConcurrentMap&) = delete;
+        ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef CPU_FEATURES_H_
+#define CPU_FEATURES_H_
+
+/*
+ * What the CPU that runs the program supports, detected at runtime.
+ *
+ * The binaries are compiled for a generic x86-64 (no -march=native)
+ * so the same binary runs everywhere. The hot loops that benefit from
+ * AVX2 or AVX-512 have one version per instruction set, compiled with
+ * __attribute__((target(...))), and the best one that the CPU supports
+ * is picked once, at runtime ("runtime dispatch").
+ *
+ * On other architectures everything is false and the generic versions
+ * are used.
+ * */
+struct CpuFeatures {
+    bool popcnt;
+    bool avx2;
+    bool avx512f;
+    bool avx512bw;
+    bool avx512vpopcntdq;
+
+    static const CpuFeatures& get() {
+        static const CpuFeatures features = detect();
+        return features;
+    }
+
+    private:
+        static CpuFeatures detect() {
+            CpuFeatures f = {false, false, false, false, false};
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            f.popcnt = __builtin_cpu_supports("popcnt");
+            f.avx2 = __builtin_cpu_supports("avx2");
+            f.avx512f = __builtin_cpu_supports("avx512f");
+            f.avx512bw = f.avx512f and __builtin_cpu_supports("avx512bw");
+            f.avx512vpopcntdq = f.avx512f and __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+            return f;
+        }
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef DENSE_REGISTRY_H_
+#define DENSE_REGISTRY_H_
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+#include <ostream>
+
+#include "popcount.h"
+
+/*
+ * Attendance list for dense integer ids in [0, max_id).
+ *
+ * Instead of a std::map<int, bool> (a tree node of ~48 bytes per id and
+ * a pointer chase per lookup) there are two bitsets, "enrolled" and
+ * "present", so the whole list takes 2 bits per id: 100 millions of ids
+ * fit in 25 MB.
+ *
+ * Each 64 bits word is a std::atomic so enroll() and mark_present()
+ * are a single fetch_or: no lock is needed and the threads only contend
+ * if they touch ids of the same word (64 ids).
+ *
+ *      DenseRegistry list(STUDENTS_CNT);
+ *      list.enroll_and_mark_present(id);   // from any thread
+ *
+ * The counts (enrolled_count() and friends) read the words as plain
+ * uint64_t with SIMD popcounts (see popcount.h): they require quiescence,
+ * no thread may enroll or mark while they run (join the threads first,
+ * as 13_fixme.cpp does before print()). Reading the words with plain
+ * loads while another thread does a fetch_or is a data race.
+ *
+ * The live_*_count() variants can run while other threads mark: each
+ * word is read with a relaxed load() and counted with a scalar popcount.
+ * They are slower and the result is not a snapshot of the whole
+ * registry (the words are read one after the other).
+ * */
+class DenseRegistry {
+    private:
+        static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+                      "the counts read the atomic words as plain words");
+        static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                      "DenseRegistry requires lock-free 64 bits atomics");
+
+        const size_t max_id;
+        const size_t words_cnt;
+        std::unique_ptr<std::atomic<uint64_t>[]> enrolled;
+        std::unique_ptr<std::atomic<uint64_t>[]> present;
+
+        static size_t word_of(size_t id) {
+            return id / 64;
+        }
+
+        static uint64_t bit_of(size_t id) {
+            return uint64_t(1) << (id % 64);
+        }
+
+        void check(size_t id) const {
+            if (id >= max_id) {
+                throw std::out_of_range("The id is out of the registry's range");
+            }
+        }
+
+        // Only for the counts without concurrent writers (see above)
+        static const uint64_t* as_words(const std::unique_ptr<std::atomic<uint64_t>[]>& bits) {
+            return reinterpret_cast<const uint64_t*>(bits.get());
+        }
+
+        // The bits set in a and not in b (b may be null), word by word
+        // with relaxed loads: safe while other threads do fetch_or
+        size_t live_count(const std::atomic<uint64_t> *a, const std::atomic<uint64_t> *b) const {
+            size_t cnt = 0;
+            for (size_t i = 0; i < words_cnt; ++i) {
+                uint64_t w = a[i].load(std::memory_order_relaxed);
+                if (b) {
+                    w &= ~b[i].load(std::memory_order_relaxed);
+                }
+                cnt += __builtin_popcountll(w);
+            }
+            return cnt;
+        }
+
+        // Return true if the bit was not set before
+        static bool set(std::atomic<uint64_t> *bits, size_t id) {
+            const uint64_t bit = bit_of(id);
+            std::atomic<uint64_t>& word = bits[word_of(id)];
+
+            // Most of the times the bit is already set (the student was
+            // enrolled by someone else): a load does not take the cache
+            // line exclusively as the fetch_or would
+            if (word.load(std::memory_order_relaxed) & bit) {
+                return false;
+            }
+            return (word.fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+        }
+
+        static bool test(const std::atomic<uint64_t> *bits, size_t id) {
+            return bits[word_of(id)].load(std::memory_order_relaxed) & bit_of(id);
+        }
+
+    public:
+        explicit DenseRegistry(size_t max_id) :
+            max_id(max_id),
+            words_cnt((max_id + 63) / 64),
+            enrolled(new std::atomic<uint64_t>[words_cnt]),
+            present(new std::atomic<uint64_t>[words_cnt]) {
+            for (size_t i = 0; i < words_cnt; ++i) {
+                enrolled[i].store(0, std::memory_order_relaxed);
+                present[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        size_t capacity() const {
+            return max_id;
+        }
+
+        // Return true if the id was not enrolled before
+        bool enroll(size_t id) {
+            check(id);
+            return set(enrolled.get(), id);
+        }
+
+        // The id must be enrolled; return true if it was not present before
+        bool mark_present(size_t id) {
+            check(id);
+            if (not test(enrolled.get(), id)) {
+                throw std::runtime_error("The student must be added to the list first");
+            }
+            return set(present.get(), id);
+        }
+
+        // The whole check/add/mark sequence of 13_fixme.cpp. Both bits
+        // are idempotent so two threads doing this with the same id
+        // is fine.
+        void enroll_and_mark_present(size_t id) {
+            check(id);
+            set(enrolled.get(), id);
+            set(present.get(), id);
+        }
+
+        bool is_enrolled(size_t id) const {
+            check(id);
+            return test(enrolled.get(), id);
+        }
+
+        bool is_present(size_t id) const {
+            check(id);
+            return test(present.get(), id);
+        }
+
+        size_t enrolled_count(PopcountImpl impl = best_popcount_impl()) const {
+            return popcount_words(as_words(enrolled), words_cnt, impl);
+        }
+
+        size_t present_count(PopcountImpl impl = best_popcount_impl()) const {
+            return popcount_words(as_words(present), words_cnt, impl);
+        }
+
+        // Enrolled but not present
+        size_t absent_count(PopcountImpl impl = best_popcount_impl()) const {
+            return popcount_words_andnot(as_words(enrolled), as_words(present), words_cnt, impl);
+        }
+
+        size_t live_enrolled_count() const {
+            return live_count(enrolled.get(), nullptr);
+        }
+
+        size_t live_present_count() const {
+            return live_count(present.get(), nullptr);
+        }
+
+        // Enrolled but not present
+        size_t live_absent_count() const {
+            return live_count(enrolled.get(), present.get());
+        }
+
+        // Call f(id, present) for each enrolled id, in order. It jumps
+        // over the empty words so a sparse registry is fast to visit.
+        template<class F>
+        void for_each_enrolled(F f) const {
+            for (size_t w = 0; w < words_cnt; ++w) {
+                uint64_t bits = enrolled[w].load(std::memory_order_relaxed);
+                const uint64_t here = present[w].load(std::memory_order_relaxed);
+                while (bits) {
+                    const unsigned int b = __builtin_ctzll(bits);
+                    f(w * 64 + b, bool(here & (uint64_t(1) << b)));
+                    bits &= bits - 1;
+                }
+            }
+        }
+
+        // Like Attendance::print of 13_fixme.cpp
+        void print(std::ostream& out) const {
+            out << "There are " << enrolled_count() << " students in the list\n";
+            out << "There are " << present_count() << " present students and ";
+            out << absent_count() << " absent students\n";
+        }
+
+        DenseRegistry(const DenseRegistry&) = delete;
+        DenseRegistry& operator=(const DenseRegistry&) = delete;
+};
+
+#endif
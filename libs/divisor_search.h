@@ -0,0 +1,192 @@
+#ifndef DIVISOR_SEARCH_H_
+#define DIVISOR_SEARCH_H_
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdint>
+
+#include "thread.h"
+#include "thread_pool.h"
+#include "thread_stats.h"
+#include "prime_table.h"
+#include "int_math.h"
+
+/*
+ * Trial division of a single number split among many threads.
+ *
+ * In 02/03 there is one thread per number: the thread of the largest
+ * number runs alone long after the others finished. A DivisorSearch
+ * splits the odd divisors of n, from 3 to sqrt(n), in blocks and any
+ * thread can help by calling work(): it takes the next block (an
+ * atomic fetch_add) until there are no blocks left.
+ *
+ * The first thread that finds a divisor sets the "found" flag; the
+ * others check it before each block and stop, so a composite stops
+ * all its helpers right away (cooperative cancellation).
+ *
+ *      DivisorSearch search(n);
+ *      ... search.work() from as many threads as you want ...
+ *      bool prime = search.is_prime();   // waits until it is known
+ *
+ * With the Thread model of 03, give all the searches to a few
+ * PrimeSearchWorker: each worker goes through all the numbers and
+ * helps with the ones not finished yet.
+ * */
+class DivisorSearch {
+    private:
+        const uint64_t n;
+        const uint64_t block_size;   // divisors per block
+        uint64_t blocks_cnt;
+
+        std::atomic<uint64_t> next_block;
+        std::atomic<bool> found;
+        std::atomic<uint64_t> tested;
+
+        std::mutex mtx;
+        std::condition_variable finished_cv;
+        uint64_t blocks_done;
+        bool decided;
+
+        void finish_blocks(uint64_t cnt, bool divisor_found) {
+            std::unique_lock<std::mutex> lck(mtx);
+            blocks_done += cnt;
+            if (divisor_found or blocks_done == blocks_cnt) {
+                decided = true;
+                finished_cv.notify_all();
+            }
+        }
+
+    public:
+        explicit DivisorSearch(uint64_t n, uint64_t block_size = 4096) :
+            n(n), block_size(block_size ? block_size : 1), blocks_cnt(0),
+            next_block(0), found(false), tested(0), blocks_done(0), decided(false) {
+            if (n < 2 or n % 2 == 0) {
+                // Nothing to search: 2 is the only even prime
+                found = (n != 2);
+                decided = true;
+                return;
+            }
+
+            if (PrimeTable::contains(n)) {
+                // Nothing to search either: look it up
+                found = not PrimeTable::is_prime(n);
+                decided = true;
+                return;
+            }
+
+            // The odd divisors 3, 5, ..., sqrt(n)
+            const uint64_t root = isqrt(n);
+            const uint64_t divisors = root >= 3 ? (root - 3) / 2 + 1 : 0;
+            blocks_cnt = (divisors + this->block_size - 1) / this->block_size;
+            decided = (blocks_cnt == 0);
+        }
+
+        uint64_t number() const {
+            return n;
+        }
+
+        // Help with the search until there is nothing left to do
+        void work() {
+            uint64_t mine = 0;
+            bool divisor_found = false;
+
+            while (not found.load(std::memory_order_relaxed)) {
+                const uint64_t b = next_block.fetch_add(1, std::memory_order_relaxed);
+                if (b >= blocks_cnt) {
+                    break;
+                }
+
+                // The odd divisors of this block, never beyond sqrt(n)
+                const uint64_t first = 3 + 2 * b * block_size;
+                const uint64_t last = first + 2 * block_size;
+                uint64_t d = first;
+                for (; d < last and d <= n / d; d += 2) {
+                    if (n % d == 0) {
+                        divisor_found = true;
+                        break;
+                    }
+                }
+
+                tested.fetch_add((d - first) / 2, std::memory_order_relaxed);
+                ++mine;
+
+                if (divisor_found) {
+                    found.store(true, std::memory_order_relaxed);
+                    break;
+                }
+            }
+
+            if (mine) {
+                finish_blocks(mine, divisor_found);
+            }
+        }
+
+        // True if the result is already known (it does not wait)
+        bool is_decided() {
+            std::unique_lock<std::mutex> lck(mtx);
+            return decided;
+        }
+
+        // Wait until the result is known
+        bool is_prime() {
+            std::unique_lock<std::mutex> lck(mtx);
+            while (not decided) {
+                ThreadStats::on_blocked();
+                finished_cv.wait(lck);
+            }
+            return not found.load(std::memory_order_relaxed);
+        }
+
+        // How many divisors were tried (less than all of them if a
+        // divisor was found and the helpers stopped)
+        uint64_t divisors_tested() const {
+            return tested.load(std::memory_order_relaxed);
+        }
+
+        DivisorSearch(const DivisorSearch&) = delete;
+        DivisorSearch& operator=(const DivisorSearch&) = delete;
+};
+
+/*
+ * A thread that helps with all the searches, starting from the first-th
+ * one so the workers spread over the numbers at the beginning.
+ * */
+class PrimeSearchWorker : public Thread {
+    private:
+        std::vector<DivisorSearch*>& searches;
+        size_t first;
+
+    public:
+        PrimeSearchWorker(std::vector<DivisorSearch*>& searches, size_t first) :
+            searches(searches), first(first) {}
+
+        virtual void run() override {
+            for (size_t i = 0; i < searches.size(); ++i) {
+                searches[(first + i) % searches.size()]->work();
+            }
+        }
+};
+
+/*
+ * Check a single number with all the threads of the pool (and the
+ * calling thread).
+ * */
+inline bool is_prime_parallel(uint64_t n, ThreadPool& pool = ThreadPool::instance()) {
+    DivisorSearch search(n);
+    if (search.is_decided()) {
+        return search.is_prime();
+    }
+
+    TaskGroup group(pool);
+    for (unsigned int i = 0; i < pool.size(); ++i) {
+        group.run([&search]() { search.work(); });
+    }
+    search.work();
+    group.wait();
+
+    return search.is_prime();
+}
+
+#endif
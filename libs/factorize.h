@@ -0,0 +1,242 @@
+#ifndef FACTORIZE_H_
+#define FACTORIZE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include "montgomery.h"
+#include "miller_rabin.h"
+#include "prime_table.h"
+#include "parallel.h"
+
+/*
+ * Prime factorization of 64 bits numbers.
+ *
+ * IsPrime of 01..03 says only yes or no. factorize(n) returns the prime
+ * factors of n, in order and repeated as many times as they divide n:
+ *
+ *      factorize(132130890) == {2, 3, 3, 5, 109, 13469}
+ *
+ * in three steps:
+ *
+ *  - trial division by the primes below FACTORIZE_TRIAL_BOUND, taken from
+ *    the compile time table (prime_table.h). Like in batch_primes.h the
+ *    % is replaced by a multiplication by the inverse of p: if p divides
+ *    n then n / p is exactly n * p^-1 mod 2^64
+ *  - what remains is either 1, a prime (is_prime_fast, miller_rabin.h)
+ *    or a product of large primes
+ *  - the latter is split with Pollard's rho, Brent's variant: a pseudo
+ *    random sequence x -> x^2 + c mod n falls in a cycle modulo each
+ *    prime factor p after ~sqrt(p) steps and gcd(x - y, n) reveals p.
+ *    The products are done with Montgomery arithmetic (montgomery.h) and
+ *    the gcds are amortized: |x - y| are multiplied together and a single
+ *    gcd is done each RHO_BLOCK steps
+ *
+ * The worst case is a product of two ~32 bits primes: ~2^16 steps of the
+ * sequence (and Brent's doubling overshoots up to 2x), about a
+ * millisecond.
+ *
+ * factorize_all() factorizes many numbers in parallel with parallel_for
+ * (parallel.h) and a dynamic schedule: the costs are very uneven from
+ * one number to the next.
+ *
+ * 0 and 1 have no prime factors: factorize() returns an empty vector.
+ * */
+#ifndef FACTORIZE_TRIAL_BOUND
+#define FACTORIZE_TRIAL_BOUND 1024
+#endif
+
+namespace factorize_detail {
+    const uint32_t TRIAL_BOUND = std::min<uint32_t>(FACTORIZE_TRIAL_BOUND, PrimeTable::bound);
+    const unsigned int RHO_BLOCK = 128;
+
+    constexpr size_t count_trial_primes() {
+        size_t cnt = 0;
+        for (const uint32_t *p = PrimeTable::begin() + 1; p != PrimeTable::end() and *p < TRIAL_BOUND; ++p) {
+            ++cnt;
+        }
+        return cnt;
+    }
+
+    const size_t TRIAL_PRIMES_CNT = count_trial_primes();
+
+    // The odd primes below TRIAL_BOUND with their inverse mod 2^64 and
+    // (2^64 - 1) / p: p divides n if and only if n * inverse <= limit
+    struct TrialPrimes {
+        uint64_t prime[TRIAL_PRIMES_CNT];
+        uint64_t inverse[TRIAL_PRIMES_CNT];
+        uint64_t limit[TRIAL_PRIMES_CNT];
+    };
+
+    constexpr TrialPrimes make_trial_primes() {
+        TrialPrimes t{};
+        for (size_t i = 0; i < TRIAL_PRIMES_CNT; ++i) {
+            const uint64_t p = PrimeTable::prime(i + 1);
+            uint64_t inv = p;
+            for (int k = 0; k < 5; ++k) {
+                inv *= 2 - p * inv;
+            }
+            t.prime[i] = p;
+            t.inverse[i] = inv;
+            t.limit[i] = UINT64_MAX / p;
+        }
+        return t;
+    }
+
+    inline constexpr TrialPrimes TRIAL_PRIMES = make_trial_primes();
+
+    // Remove the factors below TRIAL_BOUND from n, appending them to out
+    inline uint64_t trial_division(uint64_t n, std::vector<uint64_t>& out) {
+        const unsigned int twos = __builtin_ctzll(n);
+        out.insert(out.end(), twos, 2);
+        n >>= twos;
+
+        const TrialPrimes& t = TRIAL_PRIMES;
+        for (size_t i = 0; i < TRIAL_PRIMES_CNT; ++i) {
+            if (t.prime[i] * t.prime[i] > n) {
+                break;
+            }
+            while (n * t.inverse[i] <= t.limit[i]) {
+                n *= t.inverse[i];  // the exact n / p
+                out.push_back(t.prime[i]);
+            }
+        }
+        return n;
+    }
+
+    inline uint64_t gcd(uint64_t a, uint64_t b) {
+        // Binary gcd: shifts and subtractions instead of divisions
+        if (a == 0) return b;
+        if (b == 0) return a;
+
+        const unsigned int shift = __builtin_ctzll(a | b);
+        a >>= __builtin_ctzll(a);
+        do {
+            b >>= __builtin_ctzll(b);
+            if (a > b) {
+                std::swap(a, b);
+            }
+            b -= a;
+        } while (b);
+        return a << shift;
+    }
+
+    /*
+     * A divisor of the odd composite n (not a prime power of a prime
+     * below TRIAL_BOUND), or n itself if this c failed and another one
+     * must be tried.
+     *
+     * The values are kept in Montgomery form: x * R and y * R differ by
+     * (x - y) * R and, R being coprime with n, gcd((x - y) * R mod n, n)
+     * is gcd(x - y, n). No conversion is needed.
+     * */
+    template<class M>
+    uint64_t rho_brent(uint64_t n, uint64_t c_seed) {
+        typedef typename M::value_type T;
+
+        const M m(n);
+        const T c = m.to(c_seed);
+        auto f = [&m, c](T x) { return m.add(m.mul(x, x), c); };
+
+        T y = m.to(2);
+        T x = y, ys = y;
+        T q = m.one();
+        uint64_t g = 1;
+
+        for (uint64_t r = 1; g == 1; r *= 2) {
+            x = y;
+            for (uint64_t i = 0; i < r; ++i) {
+                y = f(y);
+            }
+
+            for (uint64_t k = 0; k < r and g == 1; k += RHO_BLOCK) {
+                ys = y;
+                const uint64_t steps = std::min<uint64_t>(RHO_BLOCK, r - k);
+                for (uint64_t i = 0; i < steps; ++i) {
+                    y = f(y);
+                    q = m.mul(q, m.sub(x, y));
+                }
+                g = gcd(q, n);
+            }
+        }
+
+        if (g == n) {
+            // The block overshot (q became 0 mod n): redo it one
+            // step at a time from its beginning
+            do {
+                ys = f(ys);
+                g = gcd(m.sub(x, ys), n);
+            } while (g == 1);
+        }
+        return g;
+    }
+
+    // Append the prime factors of n (odd, without small factors) to out
+    inline void split(uint64_t n, std::vector<uint64_t>& out) {
+        if (n == 1) {
+            return;
+        }
+        if (is_prime_fast(n)) {
+            out.push_back(n);
+            return;
+        }
+
+        uint64_t d = n;
+        for (uint64_t c = 1; d == n; ++c) {
+            d = n < ((uint64_t)1 << 32) ? rho_brent<Montgomery32>(n, c)
+                                        : rho_brent<Montgomery64>(n, c);
+        }
+
+        split(d, out);
+        split(n / d, out);
+    }
+}
+
+// The prime factors of n in ascending order, with repetitions
+inline std::vector<uint64_t> factorize(uint64_t n) {
+    using namespace factorize_detail;
+
+    std::vector<uint64_t> factors;
+    if (n < 2) {
+        return factors;
+    }
+
+    n = trial_division(n, factors);
+
+    // No factor below TRIAL_BOUND: any n < TRIAL_BOUND^2 is a prime
+    if (n < (uint64_t)TRIAL_BOUND * TRIAL_BOUND) {
+        if (n > 1) {
+            factors.push_back(n);
+        }
+        return factors;
+    }
+
+    const size_t small = factors.size();
+    split(n, factors);
+    std::sort(factors.begin() + small, factors.end());
+    return factors;
+}
+
+/*
+ * Factorize nums[i] into out[i] for each i, in parallel. out is resized
+ * to the size of nums.
+ * */
+inline void factorize_all(const std::vector<uint64_t>& nums,
+                          std::vector<std::vector<uint64_t> >& out,
+                          ThreadPool& pool = ThreadPool::instance()) {
+    out.resize(nums.size());
+    parallel_for(0, nums.size(), [&nums, &out](size_t i) {
+        out[i] = factorize(nums[i]);
+    }, Schedule::DYNAMIC, 16, pool);
+}
+
+inline std::vector<std::vector<uint64_t> > factorize_all(const std::vector<uint64_t>& nums,
+                                                         ThreadPool& pool = ThreadPool::instance()) {
+    std::vector<std::vector<uint64_t> > out;
+    factorize_all(nums, out, pool);
+    return out;
+}
+
+#endif
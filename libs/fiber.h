@@ -0,0 +1,620 @@
+#ifndef FIBER_H_
+#define FIBER_H_
+
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <queue>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <climits>
+#include <new>
+
+#include "thread.h"
+#include "queue.h"
+
+class Fiber;
+class FiberScheduler;
+
+/*
+ * Stacks for the fibers.
+ *
+ * The stacks are carved from big slabs reserved with mmap(MAP_NORESERVE):
+ * the kernel gives us physical pages only when the fiber touches them
+ * so a fiber that uses 4KB of its 64KB stack costs 4KB of RAM.
+ * In that sense the stacks "grow" on demand.
+ *
+ * We don't do one mmap per stack because the kernel limits the count of
+ * mappings of a process (/proc/sys/vm/max_map_count, ~65k by default)
+ * and we want 100k+ fibers. For the same reason the guard pages
+ * (to catch a stack overflow) are optional: each one splits the slab
+ * in more mappings.
+ *
+ * Stacks of finished fibers are recycled.
+ * */
+class FiberStackPool {
+    private:
+        static const size_t STACKS_PER_SLAB = 1024;
+
+        const size_t stack_size;
+        const bool guard_pages;
+
+        std::mutex mtx;
+        std::vector<void*> slabs;
+        std::vector<char*> free_stacks;
+
+        void add_slab() {
+            const size_t len = stack_size * STACKS_PER_SLAB;
+            void *slab = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (slab == MAP_FAILED) {
+                throw std::runtime_error("Cannot allocate the stacks for the fibers");
+            }
+
+            slabs.push_back(slab);
+
+            // The stacks grow downwards: the guard page is the lowest one
+            const size_t page = sysconf(_SC_PAGESIZE);
+            for (size_t i = STACKS_PER_SLAB; i > 0; --i) {
+                char *stack = (char*)slab + (i-1) * stack_size;
+                if (guard_pages) {
+                    mprotect(stack, page, PROT_NONE);
+                }
+                free_stacks.push_back(stack);
+            }
+        }
+
+    public:
+        FiberStackPool(size_t stack_size, bool guard_pages) :
+            stack_size(stack_size), guard_pages(guard_pages) {
+            const size_t page = sysconf(_SC_PAGESIZE);
+            if (stack_size % page != 0 or stack_size < 4 * page) {
+                throw std::runtime_error("The fiber stack size must be a multiple of the page size and at least 4 pages");
+            }
+        }
+
+        size_t size_of_stack() const {
+            return stack_size;
+        }
+
+        char* acquire() {
+            std::unique_lock<std::mutex> lck(mtx);
+            if (free_stacks.empty()) {
+                add_slab();
+            }
+
+            char *stack = free_stacks.back();
+            free_stacks.pop_back();
+            return stack;
+        }
+
+        void release(char *stack) {
+            std::unique_lock<std::mutex> lck(mtx);
+            free_stacks.push_back(stack);
+        }
+
+        ~FiberStackPool() {
+            for (void *slab : slabs) {
+                munmap(slab, stack_size * STACKS_PER_SLAB);
+            }
+        }
+
+        FiberStackPool(const FiberStackPool&) = delete;
+        FiberStackPool& operator=(const FiberStackPool&) = delete;
+};
+
+/*
+ * Conditional variable aware of fibers.
+ *
+ * A fiber that waits does *not* block the kernel thread: the fiber is
+ * parked in an intrusive list and the worker goes on running other
+ * fibers. A plain thread (like main()) that waits blocks as usual
+ * on a std::condition_variable.
+ *
+ * Like std::condition_variable, it must be used with a
+ * std::unique_lock<std::mutex> taken and inside of a while loop.
+ * The notify methods must be called with the same mutex taken.
+ * */
+class FiberCondition {
+    private:
+        Fiber *head;
+        Fiber *tail;
+        std::condition_variable cv;
+
+    public:
+        FiberCondition() : head(nullptr), tail(nullptr) {}
+
+        inline void wait(std::unique_lock<std::mutex>& lck);
+        inline void notify_one();
+        inline void notify_all();
+
+        FiberCondition(const FiberCondition&) = delete;
+        FiberCondition& operator=(const FiberCondition&) = delete;
+};
+
+/*
+ * A Fiber is a "thread" managed in user space: a lot of fibers are
+ * multiplexed over a few kernel threads (the workers of a FiberScheduler)
+ *
+ * It has the same interface than Thread: you inherit from Fiber,
+ * you implement run() and you call start(), join() and friends.
+ * Porting a Thread subclass is a matter of changing the base class
+ * and replacing the blocking calls by their fiber-aware versions:
+ *
+ *  - std::this_thread::sleep_for  -> Fiber::sleep_for
+ *  - Queue<T>                     -> FiberQueue<T>
+ *  - std::condition_variable      -> FiberCondition
+ *
+ * A blocking call that is not fiber-aware (like a std::mutex held for a
+ * long time or a read() from a socket) blocks the whole worker and all
+ * its fibers. Don't do that.
+ *
+ * A fiber may be resumed in a different kernel thread than the one where
+ * it was suspended so thread_local variables are not "fiber local".
+ *
+ * Like Thread, a Fiber cannot be copied nor moved and it should live in
+ * the heap (see 03_is_prime_parallel_by_inheritance.cpp)
+ * */
+class Fiber : public Runnable {
+    private:
+        friend class FiberScheduler;
+        friend class FiberWorker;
+        friend class FiberTimer;
+        friend class FiberCondition;
+
+        FiberScheduler& sched;
+
+        char *stack;
+        ucontext_t *ctx;
+
+        std::atomic<bool> _keep_running;
+        std::atomic<bool> _is_alive;
+
+        std::mutex mtx;
+        bool finished;
+        FiberCondition is_finished;
+
+        // Intrusive links for the FiberCondition's list
+        Fiber *next_waiter;
+
+        std::chrono::steady_clock::time_point wake_up_at;
+
+        static void trampoline();
+        inline void main();
+
+        // Save the context of this fiber (that must be the calling one)
+        // and jump to the worker. Once the context is saved, the worker
+        // calls after_switch(arg).
+        //
+        // This "after switch" is what allows us to put the fiber in a
+        // wait list and release a lock *after* the fiber's context
+        // was saved: otherwise another worker could resume it
+        // before that.
+        inline void suspend(void (*after_switch)(void*), void *arg);
+
+    protected:
+        bool should_keep_running() const {
+            return _keep_running;
+        }
+
+    public:
+        inline Fiber();
+        explicit Fiber(FiberScheduler& sched) :
+            sched(sched), stack(nullptr), ctx(nullptr),
+            _keep_running(true), _is_alive(false),
+            finished(true), next_waiter(nullptr) {}
+
+        inline void start() override;
+
+        void join() override {
+            std::unique_lock<std::mutex> lck(mtx);
+            while (not finished) {
+                is_finished.wait(lck);
+            }
+        }
+
+        void stop() override {
+            _keep_running = false;
+        }
+
+        bool is_alive() const override {
+            return _is_alive;
+        }
+
+        virtual void run() = 0;
+        virtual ~Fiber() {}
+
+        // The fiber that is running in the calling thread or nullptr
+        // if the caller is not a fiber.
+        static inline Fiber* current();
+
+        // Suspend the calling fiber for the given time without blocking
+        // the kernel thread. If the caller is not a fiber, it is just
+        // a std::this_thread::sleep_for
+        template<class Rep, class Period>
+        static void sleep_for(const std::chrono::duration<Rep, Period>& d);
+
+        // Let other fibers run (or yield the kernel thread if the caller
+        // is not a fiber)
+        static inline void yield();
+
+        Fiber(const Fiber&) = delete;
+        Fiber& operator=(const Fiber&) = delete;
+
+        Fiber(Fiber&& other) = delete;
+        Fiber& operator=(Fiber&& other) = delete;
+};
+
+/*
+ * Kernel thread that runs fibers: it pops a ready fiber, switches to it
+ * and when the fiber suspends itself (sleep, wait, yield or finish)
+ * the worker gets the control back.
+ * */
+class FiberWorker : public Thread {
+    private:
+        friend class Fiber;
+
+        Queue<Fiber*>& ready;
+
+        ucontext_t ctx;
+        Fiber *running;
+
+        void (*after_switch)(void*);
+        void *after_switch_arg;
+
+        // The accessors of the thread local are not inlined on purpose:
+        // a fiber may be suspended in one thread and resumed in another
+        // and the compiler could reuse the address of the thread local
+        // of the first thread.
+        __attribute__((noinline)) static FiberWorker*& current_slot() {
+            static thread_local FiberWorker *current = nullptr;
+            return current;
+        }
+
+    public:
+        explicit FiberWorker(Queue<Fiber*>& ready) :
+            ready(ready), running(nullptr),
+            after_switch(nullptr), after_switch_arg(nullptr) {}
+
+        __attribute__((noinline)) static FiberWorker* current() {
+            return current_slot();
+        }
+
+        virtual void run() override {
+            current_slot() = this;
+
+            while (true) {
+                Fiber *fiber;
+                try {
+                    fiber = ready.pop();
+                } catch (const ClosedQueue&) {
+                    break;
+                }
+
+                running = fiber;
+                swapcontext(&ctx, fiber->ctx);
+                running = nullptr;
+
+                if (after_switch) {
+                    void (*fn)(void*) = after_switch;
+                    after_switch = nullptr;
+                    fn(after_switch_arg);
+                }
+            }
+
+            current_slot() = nullptr;
+        }
+};
+
+/*
+ * Kernel thread that wakes up the sleeping fibers.
+ * */
+class FiberTimer : public Thread {
+    private:
+        struct Entry {
+            std::chrono::steady_clock::time_point deadline;
+            Fiber *fiber;
+
+            bool operator>(const Entry& other) const {
+                return deadline > other.deadline;
+            }
+        };
+
+        Queue<Fiber*>& ready;
+
+        std::mutex mtx;
+        std::condition_variable changed;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > sleeping;
+
+    public:
+        explicit FiberTimer(Queue<Fiber*>& ready) : ready(ready) {}
+
+        void add(Fiber *fiber) {
+            std::unique_lock<std::mutex> lck(mtx);
+            sleeping.push({fiber->wake_up_at, fiber});
+            if (sleeping.top().fiber == fiber) {
+                changed.notify_all();
+            }
+        }
+
+        virtual void run() override {
+            std::unique_lock<std::mutex> lck(mtx);
+            while (should_keep_running()) {
+                if (sleeping.empty()) {
+                    changed.wait(lck);
+                    continue;
+                }
+
+                const auto deadline = sleeping.top().deadline;
+                if (deadline > std::chrono::steady_clock::now()) {
+                    changed.wait_until(lck, deadline);
+                    continue;
+                }
+
+                ready.push(sleeping.top().fiber);
+                sleeping.pop();
+            }
+        }
+
+        void stop() override {
+            std::unique_lock<std::mutex> lck(mtx);
+            Thread::stop();
+            changed.notify_all();
+        }
+};
+
+/*
+ * Runs fibers over a fixed set of kernel threads (workers).
+ *
+ * The ready fibers wait in a single Queue<Fiber*> shared by all the
+ * workers; sleeping fibers are kept by a timer thread until their
+ * deadline.
+ *
+ * The destructor waits until all the started fibers finish.
+ * */
+class FiberScheduler {
+    private:
+        friend class Fiber;
+
+        FiberStackPool stacks;
+        Queue<Fiber*> ready;
+
+        FiberTimer timer;
+        std::vector<Thread*> workers;
+
+        std::mutex mtx;
+        std::condition_variable no_fibers;
+        unsigned long alive_cnt;
+
+        void spawn(Fiber *fiber) {
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                ++alive_cnt;
+            }
+            ready.push(fiber);
+        }
+
+        void exited() {
+            std::unique_lock<std::mutex> lck(mtx);
+            --alive_cnt;
+            if (alive_cnt == 0) {
+                no_fibers.notify_all();
+            }
+        }
+
+    public:
+        static const size_t DEFAULT_STACK_SIZE = 64 * 1024;
+
+        explicit FiberScheduler(unsigned int workers_cnt = std::thread::hardware_concurrency(),
+                                size_t stack_size = DEFAULT_STACK_SIZE,
+                                bool guard_pages = false) :
+            stacks(stack_size, guard_pages), ready(UINT_MAX-1),
+            timer(ready), alive_cnt(0) {
+            if (workers_cnt == 0) {
+                workers_cnt = 1;
+            }
+
+            timer.start();
+            for (unsigned int i = 0; i < workers_cnt; ++i) {
+                Thread *t = new FiberWorker(ready);
+                workers.push_back(t);
+                t->start();
+            }
+        }
+
+        // The scheduler used by the fibers that don't say otherwise:
+        // one worker per core.
+        static FiberScheduler& instance() {
+            static FiberScheduler sched;
+            return sched;
+        }
+
+        // Put a suspended fiber back in the ready queue
+        void wake_up(Fiber *fiber) {
+            ready.push(fiber);
+        }
+
+        void wait_all() {
+            std::unique_lock<std::mutex> lck(mtx);
+            while (alive_cnt > 0) {
+                no_fibers.wait(lck);
+            }
+        }
+
+        ~FiberScheduler() {
+            wait_all();
+
+            ready.close();
+            for (Thread *t : workers) {
+                t->join();
+                delete t;
+            }
+
+            timer.stop();
+            timer.join();
+        }
+
+        FiberScheduler(const FiberScheduler&) = delete;
+        FiberScheduler& operator=(const FiberScheduler&) = delete;
+};
+
+
+Fiber::Fiber() : Fiber(FiberScheduler::instance()) {}
+
+void Fiber::start() {
+    {
+        std::unique_lock<std::mutex> lck(mtx);
+        if (not finished) {
+            throw std::runtime_error("The fiber is already running");
+        }
+        finished = false;
+    }
+
+    _is_alive = true;
+    _keep_running = true;
+
+    // The context lives at the top of the stack so a fiber does not
+    // need any other allocation
+    const size_t size = sched.stacks.size_of_stack();
+    stack = sched.stacks.acquire();
+
+    const size_t ctx_offset = (size - sizeof(ucontext_t)) & ~(size_t)63;
+    ctx = new (stack + ctx_offset) ucontext_t;
+
+    getcontext(ctx);
+    ctx->uc_stack.ss_sp = stack;
+    ctx->uc_stack.ss_size = ctx_offset;
+    ctx->uc_link = nullptr;
+    makecontext(ctx, &Fiber::trampoline, 0);
+
+    sched.spawn(this);
+}
+
+void Fiber::trampoline() {
+    Fiber::current()->main();
+}
+
+void Fiber::main() {
+    try {
+        this->run();
+    } catch(const std::exception &err) {
+        std::cerr << "Unexpected exception: " << err.what() << "\n";
+    } catch(...) {
+        std::cerr << "Unexpected exception: <unknown>\n";
+    }
+
+    // We cannot release our own stack while we are running on it:
+    // the worker will do it after the switch
+    suspend([](void *arg) {
+        Fiber *self = (Fiber*)arg;
+        FiberScheduler& sched = self->sched;
+
+        sched.stacks.release(self->stack);
+        self->_is_alive = false;
+        {
+            // After this block a joiner may delete the fiber:
+            // do not touch self anymore
+            std::unique_lock<std::mutex> lck(self->mtx);
+            self->finished = true;
+            self->is_finished.notify_all();
+        }
+
+        sched.exited();
+    }, this);
+}
+
+void Fiber::suspend(void (*after_switch)(void*), void *arg) {
+    FiberWorker *worker = FiberWorker::current();
+    worker->after_switch = after_switch;
+    worker->after_switch_arg = arg;
+    swapcontext(ctx, &worker->ctx);
+}
+
+Fiber* Fiber::current() {
+    FiberWorker *worker = FiberWorker::current();
+    return worker ? worker->running : nullptr;
+}
+
+template<class Rep, class Period>
+void Fiber::sleep_for(const std::chrono::duration<Rep, Period>& d) {
+    Fiber *self = current();
+    if (not self) {
+        std::this_thread::sleep_for(d);
+        return;
+    }
+
+    self->wake_up_at = std::chrono::steady_clock::now() + d;
+    self->suspend([](void *arg) {
+        Fiber *self = (Fiber*)arg;
+        self->sched.timer.add(self);
+    }, self);
+}
+
+void Fiber::yield() {
+    Fiber *self = current();
+    if (not self) {
+        std::this_thread::yield();
+        return;
+    }
+
+    self->suspend([](void *arg) {
+        Fiber *self = (Fiber*)arg;
+        self->sched.wake_up(self);
+    }, self);
+}
+
+
+void FiberCondition::wait(std::unique_lock<std::mutex>& lck) {
+    Fiber *self = Fiber::current();
+    if (not self) {
+        cv.wait(lck);
+        return;
+    }
+
+    self->next_waiter = nullptr;
+    if (tail) {
+        tail->next_waiter = self;
+    } else {
+        head = self;
+    }
+    tail = self;
+
+    // Release the lock only after our context was saved, otherwise
+    // a notify_*() could wake us up before we went to sleep
+    self->suspend([](void *mtx) {
+        ((std::mutex*)mtx)->unlock();
+    }, lck.mutex());
+
+    lck.mutex()->lock();
+}
+
+void FiberCondition::notify_one() {
+    if (head) {
+        Fiber *fiber = head;
+        head = fiber->next_waiter;
+        if (not head) {
+            tail = nullptr;
+        }
+        fiber->sched.wake_up(fiber);
+    }
+    cv.notify_one();
+}
+
+void FiberCondition::notify_all() {
+    while (head) {
+        Fiber *fiber = head;
+        head = fiber->next_waiter;
+        fiber->sched.wake_up(fiber);
+    }
+    tail = nullptr;
+    cv.notify_all();
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef FIBER_QUEUE_H_
+#define FIBER_QUEUE_H_
+
+#include <mutex>
+#include <queue>
+#include <deque>
+#include <climits>
+#include <stdexcept>
+
+#include "fiber.h"
+#include "queue.h"
+
+/*
+ * Multiproducer/Multiconsumer Blocking Queue (MPMC) for fibers
+ *
+ * Same interface and semantics than Queue<T> but the blocking
+ * operations push() and pop() suspend the calling fiber instead
+ * of blocking the kernel thread (see FiberCondition).
+ *
+ * It can be used by plain threads too: they block as usual.
+ *
+ * On a closed queue, any method will raise ClosedQueue.
+ *
+ * */
+template<typename T, class C = std::deque<T> >
+class FiberQueue {
+    private:
+        std::queue<T, C> q;
+        const unsigned int max_size;
+
+        bool closed;
+
+        std::mutex mtx;
+        FiberCondition is_not_full;
+        FiberCondition is_not_empty;
+
+    public:
+        FiberQueue() : max_size(UINT_MAX-1), closed(false) {}
+        explicit FiberQueue(const unsigned int max_size) : max_size(max_size), closed(false) {}
+
+
+        bool try_push(T const& val) {
+            std::unique_lock<std::mutex> lck(mtx);
+
+            if (closed) {
+                throw ClosedQueue();
+            }
+
+            if (q.size() == this->max_size) {
+                return false;
+            }
+
+            if (q.empty()) {
+                is_not_empty.notify_all();
+            }
+
+            q.push(val);
+            return true;
+        }
+
+        bool try_pop(T& val) {
+            std::unique_lock<std::mutex> lck(mtx);
+
+            if (q.empty()) {
+                if (closed) {
+                    throw ClosedQueue();
+                }
+                return false;
+            }
+
+            if (q.size() == this->max_size) {
+                is_not_full.notify_all();
+            }
+
+            val = q.front();
+            q.pop();
+            return true;
+        }
+
+        void push(T const& val) {
+            std::unique_lock<std::mutex> lck(mtx);
+
+            if (closed) {
+                throw ClosedQueue();
+            }
+
+            while (q.size() == this->max_size) {
+                is_not_full.wait(lck);
+            }
+
+            if (q.empty()) {
+                is_not_empty.notify_all();
+            }
+
+            q.push(val);
+        }
+
+
+        T pop() {
+            std::unique_lock<std::mutex> lck(mtx);
+
+            while (q.empty()) {
+                if (closed) {
+                    throw ClosedQueue();
+                }
+                is_not_empty.wait(lck);
+            }
+
+            if (q.size() == this->max_size) {
+                is_not_full.notify_all();
+            }
+
+            T const val = q.front();
+            q.pop();
+
+            return val;
+        }
+
+        void close() {
+            std::unique_lock<std::mutex> lck(mtx);
+
+            if (closed) {
+                throw std::runtime_error("The queue is already closed.");
+            }
+
+            closed = true;
+            is_not_empty.notify_all();
+        }
+
+    private:
+        FiberQueue(const FiberQueue&) = delete;
+        FiberQueue& operator=(const FiberQueue&) = delete;
+
+};
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef FLAT_COMBINING_H_
+#define FLAT_COMBINING_H_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "cache_line.h"
+
+/*
+ * Flat-combining monitor.
+ *
+ * With a plain monitor, when a lot of threads want to run a critical
+ * section at the same time, most of the time is spent passing the mutex
+ * (and the cache lines of the protected object) from one core to another.
+ *
+ * With flat combining a thread does not wait for the lock to run its
+ * critical section: it *publishes* it in a slot and whoever holds the
+ * lock (the "combiner") runs all the published critical sections in one
+ * pass. The protected object stays hot in the cache of the combiner and
+ * the lock changes hands once per batch instead of once per operation.
+ *
+ * The interface is the same than Monitor<T>::with():
+ *
+ *      FlatCombining<Attendance> list;
+ *      list.apply([id](Attendance& l) { ... });
+ *
+ * The critical section runs in *another* thread (the combiner) so it
+ * must not depend on thread_local state. Exceptions are rethrown in the
+ * thread that called apply().
+ *
+ * If nobody holds the lock, apply() takes it and runs the critical
+ * section right away (like a plain monitor) and then the published ones.
+ *
+ * There are SLOTS slots; each thread gets one the first time and if it
+ * is taken, it uses the next free one. If all are taken it waits to be
+ * the combiner.
+ * */
+template<typename T, size_t SLOTS = 64>
+class FlatCombining {
+    private:
+        struct Request {
+            void (*fn)(void *ctx, T& obj);
+            void *ctx;
+            std::exception_ptr err;
+            std::atomic<bool> done;
+
+            Request(void (*fn)(void*, T&), void *ctx) : fn(fn), ctx(ctx), done(false) {}
+        };
+
+        struct alignas(CACHE_LINE_SIZE) Slot {
+            std::atomic<Request*> req;
+            Slot() : req(nullptr) {}
+        };
+
+        T obj;
+        Slot slots[SLOTS];
+        std::mutex combiner;
+
+        // Slots handed out so far: the combiner scans only these
+        std::atomic<size_t> next_slot;
+
+        // A thread remembers its slot in the last FlatCombining used
+        size_t slot_of_this_thread() {
+            struct Cached {
+                const void *owner;
+                size_t slot;
+            };
+            static thread_local Cached cached = {nullptr, 0};
+
+            if (cached.owner != this) {
+                cached.owner = this;
+                cached.slot = next_slot.fetch_add(1, std::memory_order_relaxed) % SLOTS;
+            }
+            return cached.slot;
+        }
+
+        size_t used_slots() const {
+            const size_t n = next_slot.load(std::memory_order_relaxed);
+            return n < SLOTS ? n : SLOTS;
+        }
+
+        // A thread that had to use a slot beyond the used ones must
+        // make the combiner scan it
+        void mark_slot_as_used(size_t i) {
+            size_t n = next_slot.load(std::memory_order_relaxed);
+            while (n < i + 1 and not next_slot.compare_exchange_weak(n, i + 1, std::memory_order_relaxed)) {
+            }
+        }
+
+        // Run all the published requests. Must be called with the
+        // combiner lock taken.
+        void combine() {
+            const size_t n = used_slots();
+            for (size_t i = 0; i < n; ++i) {
+                Request *r = slots[i].req.load(std::memory_order_acquire);
+                if (not r) {
+                    continue;
+                }
+
+                run(*r);
+
+                // Free the slot *before* saying that the request is done:
+                // once done, the requester may destroy it
+                slots[i].req.store(nullptr, std::memory_order_relaxed);
+                r->done.store(true, std::memory_order_release);
+            }
+        }
+
+        void run(Request& r) {
+            try {
+                r.fn(r.ctx, obj);
+            } catch (...) {
+                r.err = std::current_exception();
+            }
+        }
+
+        void execute(Request& r) {
+            // Fast path: nobody holds the lock, run it as a plain monitor
+            // and then help the others that published meanwhile
+            if (combiner.try_lock()) {
+                run(r);
+                combine();
+                combiner.unlock();
+            } else {
+                publish_and_wait(r);
+            }
+
+            if (r.err) {
+                std::rethrow_exception(r.err);
+            }
+        }
+
+        void publish_and_wait(Request& r) {
+            Slot *slot = nullptr;
+            const size_t first = slot_of_this_thread();
+            for (size_t i = 0; i < SLOTS and not slot; ++i) {
+                const size_t idx = (first + i) % SLOTS;
+                Request *expected = nullptr;
+                if (slots[idx].req.compare_exchange_strong(expected, &r, std::memory_order_release)) {
+                    slot = &slots[idx];
+                    mark_slot_as_used(idx);
+                }
+            }
+
+            unsigned int spins = 0;
+            while (not r.done.load(std::memory_order_acquire)) {
+                if (combiner.try_lock()) {
+                    if (not slot) {
+                        // No slot was free: run it ourselves
+                        run(r);
+                        r.done.store(true, std::memory_order_relaxed);
+                    }
+
+                    combine();
+                    combiner.unlock();
+                } else if (++spins % 64 == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        template<class F, class R>
+        struct Call {
+            F& f;
+            std::optional<R> result;
+
+            static void invoke(void *ctx, T& obj) {
+                Call *self = (Call*)ctx;
+                self->result.emplace(self->f(obj));
+            }
+        };
+
+        template<class F>
+        struct VoidCall {
+            F& f;
+
+            static void invoke(void *ctx, T& obj) {
+                VoidCall *self = (VoidCall*)ctx;
+                self->f(obj);
+            }
+        };
+
+    public:
+        template<typename... Args>
+        explicit FlatCombining(Args&&... args) :
+            obj(std::forward<Args>(args)...), next_slot(0) {}
+
+        template<class F>
+        auto apply(F f) -> decltype(f(obj)) {
+            typedef decltype(f(obj)) R;
+
+            if constexpr (std::is_void<R>::value) {
+                VoidCall<F> call{f};
+                Request r(&VoidCall<F>::invoke, &call);
+                execute(r);
+            } else {
+                Call<F, R> call{f, std::nullopt};
+                Request r(&Call<F, R>::invoke, &call);
+                execute(r);
+                return std::move(*call.result);
+            }
+        }
+
+        FlatCombining(const FlatCombining&) = delete;
+        FlatCombining& operator=(const FlatCombining&) = delete;
+};
+
+#endif
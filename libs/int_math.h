@@ -0,0 +1,42 @@
+#ifndef INT_MATH_H_
+#define INT_MATH_H_
+
+#include <cstdint>
+#include <cmath>
+
+/*
+ * Small integer helpers shared by the libs.
+ * */
+
+/*
+ * The largest r with r * r <= n.
+ *
+ * std::sqrt of a double is off by one for large n (a double has 53 bits
+ * of mantissa) so the estimate is fixed up; r is at most 2^32 - 1 or
+ * r * r would overflow.
+ * */
+inline uint64_t isqrt(uint64_t n) {
+    uint64_t r = (uint64_t)std::sqrt((double)n);
+    if (r > UINT32_MAX) r = UINT32_MAX;
+    while (r * r > n) --r;
+    while (r < UINT32_MAX and (r + 1) * (r + 1) <= n) ++r;
+    return r;
+}
+
+/*
+ * Mix the bits of a hash (the finalizer of MurmurHash3): std::hash of an
+ * integer is the integer itself, so consecutive keys would fall in
+ * consecutive slots and always in the same shard. After mixing, each
+ * bit of h depends on all of them and both the high bits (for a shard)
+ * and the low bits (for a slot) look random.
+ * */
+inline uint64_t mix_hash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * A read only file mapped in memory (mmap).
+ *
+ * The sums of 04..07 read a 10 elements array from the stack. For an
+ * array of GBs in a file, reading it with read() copies each byte from
+ * the page cache to our buffer; mapping it lets the threads read the
+ * page cache directly, and the kernel loads the pages on demand (page
+ * faults) as they are touched.
+ *
+ *      MappedFile file("nums.bin");
+ *      const uint32_t *nums = file.as<uint32_t>();
+ *      size_t cnt = file.count<uint32_t>();
+ *
+ * Options (all of them are hints, the contents are the same):
+ *
+ *  - sequential: madvise(MADV_SEQUENTIAL), aggressive read-ahead and
+ *    the pages already read are the first ones to be dropped
+ *  - populate: mmap(MAP_POPULATE), the whole file is read (and the
+ *    page tables filled) before the constructor returns: no page faults
+ *    later, but the constructor takes as long as reading the file
+ *  - hugepages: madvise(MADV_HUGEPAGE), ask for 2 MB pages (fewer TLB
+ *    misses). Most filesystems ignore it for file mappings; tmpfs
+ *    honors it when its transparent huge pages are enabled
+ *
+ * page_aligned_chunks() splits the elements among threads so that each
+ * chunk starts on a page boundary: two threads never fault the same
+ * page.
+ *
+ * Errors (the file cannot be opened or mapped) are thrown as
+ * std::runtime_error.
+ * */
+class MappedFile {
+    public:
+        struct Options {
+            bool sequential = true;
+            bool populate = false;
+            bool hugepages = false;
+        };
+
+    private:
+        void *addr;
+        size_t len;
+
+        // err is the errno of the failed call, saved before close() may
+        // overwrite it
+        static std::runtime_error error(const std::string& what, const std::string& path, int err) {
+            return std::runtime_error(what + " " + path + ": " + strerror(err));
+        }
+
+    public:
+        explicit MappedFile(const std::string& path) : MappedFile(path, Options()) {}
+
+        MappedFile(const std::string& path, const Options& options) : addr(nullptr), len(0) {
+            const int fd = open(path.c_str(), O_RDONLY);
+            if (fd == -1) {
+                throw error("Cannot open", path, errno);
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) == -1) {
+                const int err = errno;
+                close(fd);
+                throw error("Cannot stat", path, err);
+            }
+            len = st.st_size;
+
+            // mmap of 0 bytes fails: an empty file is an empty mapping
+            int map_err = 0;
+            if (len > 0) {
+                const int flags = MAP_PRIVATE | (options.populate ? MAP_POPULATE : 0);
+                addr = mmap(nullptr, len, PROT_READ, flags, fd, 0);
+                map_err = errno;
+            }
+
+            // The mapping keeps its own reference to the file
+            close(fd);
+
+            if (addr == MAP_FAILED) {
+                throw error("Cannot map", path, map_err);
+            }
+
+            // Hints: if the kernel does not support them, nothing changes
+            if (addr and options.sequential) {
+                madvise(addr, len, MADV_SEQUENTIAL);
+            }
+#ifdef MADV_HUGEPAGE
+            if (addr and options.hugepages) {
+                madvise(addr, len, MADV_HUGEPAGE);
+            }
+#endif
+        }
+
+        const uint8_t* data() const {
+            return (const uint8_t*)addr;
+        }
+
+        size_t size() const {
+            return len;
+        }
+
+        // The file as an array of T (the trailing bytes that do not
+        // make a whole T are not counted)
+        template<typename T>
+        const T* as() const {
+            return (const T*)addr;
+        }
+
+        template<typename T>
+        size_t count() const {
+            return len / sizeof(T);
+        }
+
+        static size_t page_size() {
+            return sysconf(_SC_PAGESIZE);
+        }
+
+        /*
+         * Split the elements of size elem_size in at most chunks ranges
+         * [first, last) of elements. Each range, except the first one,
+         * starts on a page boundary; elem_size must divide the page size.
+         * */
+        std::vector<std::pair<size_t, size_t> > page_aligned_chunks(size_t chunks, size_t elem_size) const {
+            const size_t page = page_size();
+            if (elem_size == 0 or page % elem_size != 0) {
+                throw std::invalid_argument("The size of an element must divide the page size");
+            }
+
+            const size_t per_page = page / elem_size;
+            const size_t elems = len / elem_size;
+            const size_t pages = (elems + per_page - 1) / per_page;
+            chunks = std::max<size_t>(1, std::min(chunks, pages));
+
+            std::vector<std::pair<size_t, size_t> > ranges;
+            for (size_t c = 0; c < chunks; ++c) {
+                const size_t first = std::min(elems, pages * c / chunks * per_page);
+                const size_t last = std::min(elems, pages * (c+1) / chunks * per_page);
+                ranges.push_back(std::make_pair(first, last));
+            }
+            return ranges;
+        }
+
+        ~MappedFile() {
+            if (addr) {
+                munmap(addr, len);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+};
+
+#endif
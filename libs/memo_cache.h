@@ -0,0 +1,210 @@
+#ifndef MEMO_CACHE_H_
+#define MEMO_CACHE_H_
+
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <cstdint>
+#include <stdexcept>
+
+#include "cache_line.h"
+#include "int_math.h"
+#include "thread_stats.h"
+
+/*
+ * Concurrent memoization cache for pure functions.
+ *
+ * The nums of 02/03 have 132130891 five times and each time a thread
+ * checks it from scratch. With a MemoCache the result of f(key) is
+ * computed once and reused:
+ *
+ *      MemoCache<uint64_t, bool> cache(4096);
+ *      bool prime = cache.get_or_compute(n, is_prime_fast);
+ *
+ *  - single flight: if a thread asks for a key that another thread is
+ *    computing right now it waits for that result instead of computing
+ *    it again (the cache stores a std::shared_future, not a value)
+ *  - bounded: at most ~capacity entries; when a shard is full its least
+ *    recently used entry is evicted (LRU)
+ *  - sharded: the keys are split in shards with their own mutex so
+ *    threads working on different keys rarely contend. f runs outside
+ *    of any lock
+ *  - stats: hits (including the ones that waited for an in-flight
+ *    computation), misses (computations) and evictions
+ *
+ * If f throws, the exception is given to all the threads waiting for
+ * that key and the key is *not* cached: the next call computes it again.
+ *
+ * f must be pure: same key, same result, and no side effects that
+ * matter (it may run in any of the threads that ask for the key).
+ * */
+template<typename K, typename V, class Hash = std::hash<K> >
+class MemoCache {
+    public:
+        struct Stats {
+            unsigned long hits = 0;
+            unsigned long inflight_waits = 0;   // hits that had to wait
+            unsigned long misses = 0;
+            unsigned long evictions = 0;
+            size_t size = 0;
+        };
+
+    private:
+        struct Entry {
+            std::shared_future<V> value;
+            typename std::list<K>::iterator lru_pos;
+            uint64_t id;
+        };
+
+        struct alignas(CACHE_LINE_SIZE) Shard {
+            mutable std::mutex mtx;
+            std::unordered_map<K, Entry, Hash> entries;
+            std::list<K> lru;   // the most recently used first
+            uint64_t next_id = 0;
+            Stats stats;
+        };
+
+        std::unique_ptr<Shard[]> shards;
+        const size_t shards_cnt;
+        const size_t capacity_per_shard;
+
+        Shard& shard_of(const K& key) {
+            return shards[mix_hash(Hash()(key)) % shards_cnt];
+        }
+
+        // The entry id is used to remove *this* entry after a failure and
+        // not a newer one for the same key
+        void forget(Shard& s, const K& key, uint64_t id) {
+            std::unique_lock<std::mutex> lck(s.mtx);
+            auto it = s.entries.find(key);
+            if (it != s.entries.end() and it->second.id == id) {
+                s.lru.erase(it->second.lru_pos);
+                s.entries.erase(it);
+            }
+        }
+
+        static V wait_for(const std::shared_future<V>& value) {
+            if (value.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ThreadStats::on_blocked();
+            }
+            return value.get();
+        }
+
+    public:
+        explicit MemoCache(size_t capacity, size_t shards_cnt = 16) :
+            shards(new Shard[shards_cnt ? shards_cnt : 1]),
+            shards_cnt(shards_cnt ? shards_cnt : 1),
+            capacity_per_shard((capacity + this->shards_cnt - 1) / this->shards_cnt) {
+            if (capacity == 0) {
+                throw std::runtime_error("The capacity of a MemoCache must be greater than 0");
+            }
+        }
+
+        // Return f(key), computing it only if it is not cached. f is
+        // taken by reference: a hit does not copy it
+        template<class F>
+        V get_or_compute(const K& key, const F& f) {
+            Shard& s = shard_of(key);
+            std::promise<V> promise;
+            uint64_t id;
+
+            {
+                std::unique_lock<std::mutex> lck(s.mtx);
+                auto it = s.entries.find(key);
+                if (it != s.entries.end()) {
+                    // Hit: move it to the front of the LRU list
+                    s.lru.splice(s.lru.begin(), s.lru, it->second.lru_pos);
+                    ++s.stats.hits;
+
+                    std::shared_future<V> value = it->second.value;
+                    if (value.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                        ++s.stats.inflight_waits;
+                    }
+
+                    lck.unlock();
+                    return wait_for(value);
+                }
+
+                // Miss: publish the future *before* computing so the
+                // others wait for us instead of computing it too
+                ++s.stats.misses;
+                if (s.entries.size() >= capacity_per_shard) {
+                    // An in-flight entry may be evicted: its waiters
+                    // keep their copy of the future
+                    s.entries.erase(s.lru.back());
+                    s.lru.pop_back();
+                    ++s.stats.evictions;
+                }
+
+                id = s.next_id++;
+                s.lru.push_front(key);
+                s.entries.emplace(key, Entry{promise.get_future().share(), s.lru.begin(), id});
+            }
+
+            try {
+                V value = f(key);
+                promise.set_value(value);
+                return value;
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+                forget(s, key, id);
+                throw;
+            }
+        }
+
+        Stats stats() const {
+            Stats total;
+            for (size_t i = 0; i < shards_cnt; ++i) {
+                std::unique_lock<std::mutex> lck(shards[i].mtx);
+                total.hits += shards[i].stats.hits;
+                total.inflight_waits += shards[i].stats.inflight_waits;
+                total.misses += shards[i].stats.misses;
+                total.evictions += shards[i].stats.evictions;
+                total.size += shards[i].entries.size();
+            }
+            return total;
+        }
+
+        void clear() {
+            for (size_t i = 0; i < shards_cnt; ++i) {
+                std::unique_lock<std::mutex> lck(shards[i].mtx);
+                shards[i].entries.clear();
+                shards[i].lru.clear();
+            }
+        }
+
+        MemoCache(const MemoCache&) = delete;
+        MemoCache& operator=(const MemoCache&) = delete;
+};
+
+/*
+ * A pure function f and a MemoCache in a single callable:
+ *
+ *      Memoized<uint64_t, bool> is_prime(is_prime_fast, 4096);
+ *      is_prime(132130891);
+ * */
+template<typename K, typename V, class Hash = std::hash<K> >
+class Memoized {
+    private:
+        std::function<V(const K&)> f;
+        MemoCache<K, V, Hash> cache;
+
+    public:
+        Memoized(std::function<V(const K&)> f, size_t capacity, size_t shards_cnt = 16) :
+            f(f), cache(capacity, shards_cnt) {}
+
+        V operator()(const K& key) {
+            return cache.get_or_compute(key, f);
+        }
+
+        typename MemoCache<K, V, Hash>::Stats stats() const {
+            return cache.stats();
+        }
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef MILLER_RABIN_H_
+#define MILLER_RABIN_H_
+
+#include <cstdint>
+
+#include "montgomery.h"
+#include "prime_table.h"
+#include "thread.h"
+
+/*
+ * Deterministic Miller-Rabin primality test for 64 bits numbers.
+ *
+ * IsPrime of 01..03 divides n by all the numbers below it: 132130891
+ * takes 132 millions of divisions. Miller-Rabin does a few modular
+ * exponentiations instead (~64 multiplications each): microseconds
+ * for any 64 bits number.
+ *
+ * In general Miller-Rabin is probabilistic but for n < 2^64 there are
+ * known sets of bases ("witnesses") that never fail:
+ *
+ *  - n < 2^32:  2, 7, 61 (Jaeschke)
+ *  - n < 2^64:  2, 325, 9375, 28178, 450775, 9780504, 1795265022 (Sinclair)
+ *
+ * The numbers below PRIME_TABLE_BOUND are just looked up in the compile
+ * time table (prime_table.h). The others are divided by the primes below
+ * 64 first: it is cheap and it sends most of the composites out without
+ * any exponentiation.
+ * The multiplications are done with Montgomery arithmetic
+ * (see montgomery.h).
+ * */
+namespace miller_rabin_detail {
+    const uint32_t SMALL_PRIMES[] = {
+        2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61
+    };
+
+    // n odd, n - 1 = d * 2^s; is n a strong probable prime to base a?
+    template<class M>
+    bool is_strong_probable_prime(const M& m, uint64_t a, uint64_t d, unsigned int s) {
+        typedef typename M::value_type T;
+
+        const T one = m.one();
+        const T minus_one = m.sub(0, one);
+
+        T x = m.pow(m.to(a), d);
+        if (x == one or x == minus_one) {
+            return true;
+        }
+
+        for (unsigned int r = 1; r < s; ++r) {
+            x = m.mul(x, x);
+            if (x == minus_one) {
+                return true;
+            }
+            if (x == one) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    template<class M, size_t N>
+    bool passes_all(uint64_t n, const uint64_t (&bases)[N]) {
+        const M m(n);
+        uint64_t d = n - 1;
+        unsigned int s = __builtin_ctzll(d);
+        d >>= s;
+
+        for (uint64_t a : bases) {
+            a %= n;
+            if (a == 0) {
+                // a multiple of n says nothing about n
+                continue;
+            }
+            if (not is_strong_probable_prime(m, a, d, s)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+inline bool is_prime_fast(uint64_t n) {
+    using namespace miller_rabin_detail;
+
+    if (PrimeTable::contains(n)) {
+        return PrimeTable::is_prime(n);
+    }
+
+    for (uint32_t p : SMALL_PRIMES) {
+        if (n % p == 0) {
+            return n == p;
+        }
+    }
+
+    if (n < ((uint64_t)1 << 32)) {
+        static const uint64_t bases[] = {2, 7, 61};
+        return passes_all<Montgomery32>(n, bases);
+    }
+
+    static const uint64_t bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+    return passes_all<Montgomery64>(n, bases);
+}
+
+/*
+ * The same functor interface than IsPrime of 01_is_prime_sequential.cpp
+ * and 02_is_prime_parallel_by_composition.cpp
+ * */
+class IsPrimeFast {
+    private:
+        uint64_t n;
+        bool &result;
+
+    public:
+        IsPrimeFast(uint64_t n, bool &result) :
+            n(n),
+            result(result) {}
+
+        void run() {
+            result = is_prime_fast(n);
+        }
+
+        void operator()() {
+            this->run();
+        }
+};
+
+/*
+ * And the active object of 03_is_prime_parallel_by_inheritance.cpp
+ * */
+class IsPrimeFastThread : public Thread {
+    private:
+        uint64_t n;
+        bool &result;
+
+    public:
+        IsPrimeFastThread(uint64_t n, bool &result) :
+            n(n),
+            result(result) {}
+
+        virtual void run() override {
+            result = is_prime_fast(n);
+        }
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef MONITOR_H_
+#define MONITOR_H_
+
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <thread>
+
+#include "cache_line.h"
+
+/*
+ * Generic monitor: an object T and the synchronization that protects it.
+ *
+ * Instead of writing a class with a mutex and one method per critical
+ * section (ResultProtected in 07, AttendanceProtected in 13) the
+ * critical section is a callable that receives the protected object:
+ *
+ *      Monitor<Attendance> list;
+ *
+ *      list.with([id](Attendance& l) {
+ *          if (not l.is_student_in_list(id))
+ *              l.add_student_to_list(id);
+ *          l.mark_attendance_of_student(id);
+ *      });
+ *
+ *      list.read([](const Attendance& l) { l.print(std::cout); });
+ *
+ * with() runs the callable with exclusive access (to modify T),
+ * read() runs it with read-only access. What "exclusive" and "read-only"
+ * cost depends on the policy:
+ *
+ *  - ExclusiveLock: a std::mutex. Reads and writes are serialized;
+ *    the cheapest when there are few readers.
+ *  - SharedLock: a std::shared_mutex. Many readers can run in parallel
+ *    but they still write to the lock itself (a shared counter) so they
+ *    do not scale perfectly.
+ *  - SeqLock: only for small trivially copyable T. Readers do not write
+ *    anything shared: they copy T and retry if a writer modified it in
+ *    the middle. read() receives a *copy* (T must be default
+ *    constructible too). with() modifies a copy and publishes it only
+ *    if the callable returns (if it throws, nothing changes). Readers
+ *    never block writers but a stream of writers may make the readers
+ *    retry a lot.
+ *
+ * The critical sections should be short and they must not call
+ * another method of the same monitor (it would deadlock).
+ * */
+struct ExclusiveLock {};
+struct SharedLock {};
+struct SeqLock {};
+
+template<typename T, class Policy = ExclusiveLock>
+class Monitor;
+
+template<typename T>
+class Monitor<T, ExclusiveLock> {
+    private:
+        mutable std::mutex mtx;
+        T obj;
+
+    public:
+        template<typename... Args>
+        explicit Monitor(Args&&... args) : obj(std::forward<Args>(args)...) {}
+
+        template<class F>
+        auto with(F f) {
+            std::unique_lock<std::mutex> lck(mtx);
+            return f(obj);
+        }
+
+        template<class F>
+        auto read(F f) const {
+            std::unique_lock<std::mutex> lck(mtx);
+            return f(static_cast<const T&>(obj));
+        }
+
+        Monitor(const Monitor&) = delete;
+        Monitor& operator=(const Monitor&) = delete;
+};
+
+template<typename T>
+class Monitor<T, SharedLock> {
+    private:
+        mutable std::shared_mutex mtx;
+        T obj;
+
+    public:
+        template<typename... Args>
+        explicit Monitor(Args&&... args) : obj(std::forward<Args>(args)...) {}
+
+        template<class F>
+        auto with(F f) {
+            std::unique_lock<std::shared_mutex> lck(mtx);
+            return f(obj);
+        }
+
+        template<class F>
+        auto read(F f) const {
+            std::shared_lock<std::shared_mutex> lck(mtx);
+            return f(static_cast<const T&>(obj));
+        }
+
+        Monitor(const Monitor&) = delete;
+        Monitor& operator=(const Monitor&) = delete;
+};
+
+/*
+ * The protected T is stored as an array of atomic words so a reader
+ * copying it while a writer modifies it is *not* a data race
+ * (a plain memcpy would be undefined behaviour) even if the copy
+ * may be torn: the sequence number tells the reader to retry.
+ *
+ * The sequence is odd while a writer is writing.
+ * */
+template<typename T>
+class Monitor<T, SeqLock> {
+    private:
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "Monitor<T, SeqLock> requires a trivially copyable T");
+
+        static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        alignas(CACHE_LINE_SIZE) std::atomic<unsigned long> seq;
+        std::atomic<uint64_t> words[WORDS];
+
+        // Writers are serialized among them by a regular mutex;
+        // readers never touch it
+        std::mutex writers_mtx;
+
+        T load_words() const {
+            uint64_t buf[WORDS];
+            for (size_t i = 0; i < WORDS; ++i) {
+                buf[i] = words[i].load(std::memory_order_relaxed);
+            }
+
+            T obj;
+            memcpy(&obj, buf, sizeof(T));
+            return obj;
+        }
+
+        void store_words(const T& obj) {
+            uint64_t buf[WORDS] = {0};
+            memcpy(buf, &obj, sizeof(T));
+
+            for (size_t i = 0; i < WORDS; ++i) {
+                words[i].store(buf[i], std::memory_order_relaxed);
+            }
+        }
+
+        // Store the words between two increments of the sequence so a
+        // reader that overlaps with the store will retry
+        void publish(const T& obj) {
+            const unsigned long s = seq.load(std::memory_order_relaxed);
+            seq.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            store_words(obj);
+            seq.store(s + 2, std::memory_order_release);
+        }
+
+    public:
+        explicit Monitor(const T& obj = T()) : seq(0) {
+            store_words(obj);
+        }
+
+        template<class F>
+        auto with(F f) {
+            std::unique_lock<std::mutex> lck(writers_mtx);
+
+            // We are the only writer: nobody can change the words
+            // under our feet. The callable modifies a copy; if it
+            // throws, the copy is discarded and nothing is published
+            T obj = load_words();
+
+            if constexpr (std::is_void<decltype(f(obj))>::value) {
+                f(obj);
+                publish(obj);
+            } else {
+                auto result = f(obj);
+                publish(obj);
+                return result;
+            }
+        }
+
+        template<class F>
+        auto read(F f) const {
+            return f(static_cast<const T&>(get()));
+        }
+
+        // A consistent copy of the protected object
+        T get() const {
+            while (true) {
+                const unsigned long s1 = seq.load(std::memory_order_acquire);
+                if (s1 & 1) {
+                    // A writer is in the middle: let it finish
+                    // (it may be waiting for our core)
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                T obj = load_words();
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                const unsigned long s2 = seq.load(std::memory_order_relaxed);
+                if (s1 == s2) {
+                    return obj;
+                }
+            }
+        }
+
+        Monitor(const Monitor&) = delete;
+        Monitor& operator=(const Monitor&) = delete;
+};
+
+#endif
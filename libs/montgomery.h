@@ -0,0 +1,162 @@
+#ifndef MONTGOMERY_H_
+#define MONTGOMERY_H_
+
+#include <cstdint>
+
+/*
+ * Modular multiplication without division: Montgomery arithmetic.
+ *
+ * a * b % n costs a division (tens of cycles for 64 bits, more for 128)
+ * and algorithms like Miller-Rabin or Pollard's rho do thousands of
+ * them with the same n. Montgomery's trick moves the numbers to a
+ * "Montgomery form" (x * R mod n, with R = 2^64 or 2^32) where
+ * a multiplication modulo n needs only multiplications and a shift.
+ *
+ *      Montgomery64 m(n);              // n must be odd
+ *      uint64_t a = m.to(x), b = m.to(y);
+ *      uint64_t c = m.from(m.mul(a, b)); // x * y % n
+ *
+ * The values in Montgomery form are in [0, n).
+ * */
+__extension__ typedef unsigned __int128 uint128_t;
+
+class Montgomery64 {
+    private:
+        uint64_t n;
+        uint64_t inv;   // n^-1 mod 2^64
+        uint64_t r2;    // 2^128 mod n
+
+        // t * 2^-64 mod n, for t < n * 2^64
+        uint64_t reduce(uint128_t t) const {
+            const uint64_t m = (uint64_t)t * inv;
+            const uint64_t hi = t >> 64;
+            const uint64_t mn = ((uint128_t)m * n) >> 64;
+            // t and m * n have the same low 64 bits so t - m * n is
+            // exactly (hi - mn) * 2^64
+            return hi >= mn ? hi - mn : hi - mn + n;
+        }
+
+    public:
+        typedef uint64_t value_type;
+
+        explicit Montgomery64(uint64_t n) : n(n), inv(n) {
+            // Newton's iteration: each step doubles the correct bits
+            // (n * n = 1 mod 8 so the first 3 are already right)
+            for (int i = 0; i < 5; ++i) {
+                inv *= 2 - n * inv;
+            }
+            const uint64_t r = (0 - n) % n; // 2^64 mod n
+            r2 = (uint128_t)r * r % n;
+        }
+
+        uint64_t modulus() const {
+            return n;
+        }
+
+        uint64_t to(uint64_t x) const {
+            return reduce((uint128_t)(x % n) * r2);
+        }
+
+        uint64_t from(uint64_t x) const {
+            return reduce(x);
+        }
+
+        uint64_t one() const {
+            return to(1);
+        }
+
+        uint64_t mul(uint64_t a, uint64_t b) const {
+            return reduce((uint128_t)a * b);
+        }
+
+        uint64_t add(uint64_t a, uint64_t b) const {
+            const uint64_t s = a + b;
+            return (s < a or s >= n) ? s - n : s;
+        }
+
+        uint64_t sub(uint64_t a, uint64_t b) const {
+            return a >= b ? a - b : a - b + n;
+        }
+
+        // a^e with a in Montgomery form
+        uint64_t pow(uint64_t a, uint64_t e) const {
+            uint64_t result = one();
+            while (e) {
+                if (e & 1) {
+                    result = mul(result, a);
+                }
+                a = mul(a, a);
+                e >>= 1;
+            }
+            return result;
+        }
+};
+
+// The same with R = 2^32 for n < 2^32: the products fit in 64 bits
+class Montgomery32 {
+    private:
+        uint32_t n;
+        uint32_t inv;
+        uint32_t r2;
+
+        uint32_t reduce(uint64_t t) const {
+            const uint32_t m = (uint32_t)t * inv;
+            const uint32_t hi = t >> 32;
+            const uint32_t mn = ((uint64_t)m * n) >> 32;
+            return hi >= mn ? hi - mn : hi - mn + n;
+        }
+
+    public:
+        typedef uint32_t value_type;
+
+        explicit Montgomery32(uint32_t n) : n(n), inv(n) {
+            for (int i = 0; i < 4; ++i) {
+                inv *= 2 - n * inv;
+            }
+            const uint32_t r = (0 - n) % n;
+            r2 = (uint64_t)r * r % n;
+        }
+
+        uint32_t modulus() const {
+            return n;
+        }
+
+        uint32_t to(uint64_t x) const {
+            return reduce((uint64_t)(uint32_t)(x % n) * r2);
+        }
+
+        uint32_t from(uint32_t x) const {
+            return reduce(x);
+        }
+
+        uint32_t one() const {
+            return to(1);
+        }
+
+        uint32_t mul(uint32_t a, uint32_t b) const {
+            return reduce((uint64_t)a * b);
+        }
+
+        uint32_t add(uint32_t a, uint32_t b) const {
+            const uint32_t s = a + b;
+            return (s < a or s >= n) ? s - n : s;
+        }
+
+        uint32_t sub(uint32_t a, uint32_t b) const {
+            return a >= b ? a - b : a - b + n;
+        }
+
+        uint32_t pow(uint32_t a, uint64_t e) const {
+            uint32_t result = one();
+            while (e) {
+                if (e & 1) {
+                    result = mul(result, a);
+                }
+                a = mul(a, a);
+                e >>= 1;
+            }
+            return result;
+        }
+};
+
+#endif
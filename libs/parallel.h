@@ -0,0 +1,307 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <iterator>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <optional>
+
+#include "thread_pool.h"
+#include "cache_line.h"
+#include "atomic_ops.h"
+
+/*
+ * Parallel algorithms on top of the ThreadPool.
+ * */
+
+/*
+ * Reduce the range [begin, end) in parallel:
+ *
+ *      combine(... combine(combine(identity, map(x0)), map(x1)) ..., map(xn))
+ *
+ * combine must be associative and identity must be its neutral element;
+ * it does not need to be commutative: the partial results are combined
+ * in the same order than the elements.
+ *
+ * This replaces the hand-made splitting of 04..07 (one Sum thread per
+ * pair of numbers and a monitor to accumulate):
+ *
+ *  - the range is split in a few big chunks (a few per thread of the
+ *    pool, never smaller than min_chunk elements) and the threads of
+ *    the pool are reused: no thread is created here
+ *  - each chunk accumulates in a local variable (a register) and writes
+ *    its partial result only once, in its own cache line
+ *  - the partial results are combined once, by the caller, at the end:
+ *    there is no shared accumulator and no mutex
+ *
+ * For small ranges the whole thing runs in the calling thread.
+ * */
+template<class It, class T, class Map, class Combine>
+T parallel_reduce(It begin, It end, T identity, Map map, Combine combine,
+                  ThreadPool& pool = ThreadPool::instance(),
+                  size_t min_chunk = 1 << 14) {
+    const size_t n = std::distance(begin, end);
+
+    // Chunks per thread: more than one so a thread that was preempted
+    // or is slower does not hold back the others
+    const size_t max_chunks = (size_t)pool.size() * 4;
+    const size_t chunks = std::min(max_chunks, n / std::max(min_chunk, (size_t)1));
+
+    if (chunks <= 1) {
+        T acc = identity;
+        for (It it = begin; it != end; ++it) {
+            acc = combine(acc, map(*it));
+        }
+        return acc;
+    }
+
+    std::vector<CacheAligned<T> > partials(chunks, CacheAligned<T>(identity));
+
+    TaskGroup group(pool);
+    for (size_t c = 0; c < chunks; ++c) {
+        const size_t lo = n * c / chunks;
+        const size_t hi = n * (c+1) / chunks;
+
+        group.run([&partials, &map, &combine, begin, lo, hi, identity, c]() {
+            T acc = identity;
+            It it = std::next(begin, lo);
+            for (size_t i = lo; i < hi; ++i, ++it) {
+                acc = combine(acc, map(*it));
+            }
+            partials[c].value = acc;
+        });
+    }
+    group.wait();
+
+    T acc = identity;
+    for (size_t c = 0; c < chunks; ++c) {
+        acc = combine(acc, partials[c].value);
+    }
+    return acc;
+}
+
+namespace parallel_detail {
+    /*
+     * Run chunk(lo, hi) over [0, n) in chunks of grain elements, taken
+     * in order by the threads of the pool (and the caller) from an
+     * atomic counter. Before taking a chunk a thread calls
+     * keep_going(lo); if it returns false the thread stops.
+     * */
+    template<class Chunk, class KeepGoing>
+    void for_each_chunk_while(size_t n, size_t grain, ThreadPool& pool,
+                              Chunk chunk, KeepGoing keep_going) {
+        grain = std::max(grain, (size_t)1);
+        std::atomic<size_t> next(0);
+
+        auto worker = [&]() {
+            while (true) {
+                const size_t lo = next.fetch_add(grain, std::memory_order_relaxed);
+                if (lo >= n or not keep_going(lo)) {
+                    break;
+                }
+                chunk(lo, std::min(lo + grain, n));
+            }
+        };
+
+        const size_t chunks = (n + grain - 1) / grain;
+        if (chunks <= 1) {
+            worker();
+            return;
+        }
+
+        TaskGroup group(pool);
+        const size_t helpers = std::min((size_t)pool.size(), chunks - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            group.run(worker);
+        }
+        worker();
+        group.wait();
+    }
+}
+
+/*
+ * Call f(i) for each i in [begin, end) in parallel.
+ *
+ * In 02/03 there is one thread per number and in 04..07 one Sum per
+ * pair of numbers: a thread that got 132130891 runs for seconds while
+ * the one that got 4 finished right away. Here a fixed set of threads
+ * (the pool plus the caller) split the range in chunks of indexes:
+ *
+ *  - STATIC: one block per thread, decided up front. The cheapest if
+ *    all the f(i) cost the same; the worst with skewed costs
+ *  - DYNAMIC: the threads take chunks of grain indexes, in order, from
+ *    an atomic counter until the range is exhausted. A thread stuck in
+ *    an expensive index does not hold back the rest
+ *  - GUIDED: like DYNAMIC but the chunks start big (the remaining /
+ *    (2 * threads)) and shrink to grain near the end: fewer atomic
+ *    operations for the same balance
+ *
+ * The chunk boundaries are always multiples of grain (from begin). If f
+ * writes out[i] and out is a CacheAlignedVector (cache_line.h), with a
+ * grain multiple of per_cache_line<T>() two threads never write to the
+ * same cache line.
+ * */
+enum class Schedule {
+    STATIC,
+    DYNAMIC,
+    GUIDED
+};
+
+template<class F>
+void parallel_for(size_t begin, size_t end, F f,
+                  Schedule schedule = Schedule::DYNAMIC, size_t grain = 1,
+                  ThreadPool& pool = ThreadPool::instance()) {
+    if (begin >= end) {
+        return;
+    }
+
+    grain = std::max(grain, (size_t)1);
+    const size_t n = end - begin;
+    const size_t chunks = (n + grain - 1) / grain;
+    const size_t threads = std::min((size_t)pool.size() + 1, chunks);
+
+    auto run_chunk = [&f, begin](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            f(begin + i);
+        }
+    };
+
+    std::atomic<size_t> next(0);
+
+    // The size of the guided chunk that starts at lo
+    auto guided_chunk = [n, grain, threads](size_t lo) {
+        const size_t wanted = std::max(grain, (n - lo) / (2 * threads));
+        return (wanted + grain - 1) / grain * grain;
+    };
+
+    auto worker = [&](size_t w) {
+        switch (schedule) {
+            case Schedule::STATIC: {
+                const size_t lo = chunks * w / threads * grain;
+                const size_t hi = std::min(chunks * (w+1) / threads * grain, n);
+                run_chunk(lo, hi);
+                break;
+            }
+
+            case Schedule::DYNAMIC:
+                while (true) {
+                    const size_t lo = next.fetch_add(grain, std::memory_order_relaxed);
+                    if (lo >= n) {
+                        break;
+                    }
+                    run_chunk(lo, std::min(lo + grain, n));
+                }
+                break;
+
+            case Schedule::GUIDED:
+                while (true) {
+                    std::optional<size_t> lo = fetch_update(next, [&](size_t cur) -> std::optional<size_t> {
+                        if (cur >= n) {
+                            return std::nullopt;
+                        }
+                        return cur + guided_chunk(cur);
+                    });
+                    if (not lo) {
+                        break;
+                    }
+                    run_chunk(*lo, std::min(*lo + guided_chunk(*lo), n));
+                }
+                break;
+        }
+    };
+
+    if (threads <= 1) {
+        worker(0);
+        return;
+    }
+
+    TaskGroup group(pool);
+    for (size_t w = 1; w < threads; ++w) {
+        group.run([&worker, w]() { worker(w); });
+    }
+    worker(0);
+    group.wait();
+}
+
+/*
+ * Search in parallel an element x of [begin, end) with pred(x) true
+ * and return an iterator to it (or end).
+ *
+ * This replaces the AreAnyPrime threads of 08: there each thread
+ * checks once, before its scan, if somebody already found a prime and
+ * then keeps scanning for hundreds of milliseconds even if the answer
+ * is already known.
+ *
+ * Here the range is split in chunks of grain elements that the threads
+ * take one after the other; between chunks a thread polls a "found"
+ * flag (a relaxed atomic load: as cheap as reading a variable) and
+ * returns as soon as any thread found something. There is no lock in
+ * the loop.
+ *
+ * parallel_find_any returns *any* element that satisfies pred (the
+ * first one found). parallel_find_first returns the first one in the
+ * order of the range, like std::find_if: a thread stops only when the
+ * found element is before its next chunk.
+ * */
+template<class It, class Pred>
+It parallel_find_any(It begin, It end, Pred pred,
+                     ThreadPool& pool = ThreadPool::instance(),
+                     size_t grain = 1024) {
+    const size_t n = std::distance(begin, end);
+    std::atomic<bool> found(false);
+    std::atomic<size_t> found_at(n);
+
+    parallel_detail::for_each_chunk_while(n, grain, pool,
+        [&](size_t lo, size_t hi) {
+            It it = std::next(begin, lo);
+            for (size_t i = lo; i < hi; ++i, ++it) {
+                if (pred(*it)) {
+                    // Keep the lowest of what the threads found
+                    update_if(found_at,
+                              [i](size_t cur) { return i < cur; },
+                              [i](size_t) { return i; });
+                    found.store(true, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        },
+        [&](size_t) { return not found.load(std::memory_order_relaxed); });
+
+    return std::next(begin, found_at.load());
+}
+
+template<class It, class Pred>
+It parallel_find_first(It begin, It end, Pred pred,
+                       ThreadPool& pool = ThreadPool::instance(),
+                       size_t grain = 1024) {
+    const size_t n = std::distance(begin, end);
+    std::atomic<size_t> found_at(n);
+
+    parallel_detail::for_each_chunk_while(n, grain, pool,
+        [&](size_t lo, size_t hi) {
+            It it = std::next(begin, lo);
+            for (size_t i = lo; i < hi; ++i, ++it) {
+                if (pred(*it)) {
+                    update_if(found_at,
+                              [i](size_t cur) { return i < cur; },
+                              [i](size_t) { return i; });
+                    return;
+                }
+            }
+        },
+        // The chunks are taken in order: a chunk after the found
+        // element cannot have a better one
+        [&](size_t lo) { return lo < found_at.load(std::memory_order_relaxed); });
+
+    return std::next(begin, found_at.load());
+}
+
+template<class It, class Pred>
+bool parallel_any_of(It begin, It end, Pred pred,
+                     ThreadPool& pool = ThreadPool::instance(),
+                     size_t grain = 1024) {
+    return parallel_find_any(begin, end, pred, pool, grain) != end;
+}
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef PERF_COUNTERS_H_
+#define PERF_COUNTERS_H_
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <iostream>
+#include <iomanip>
+
+/*
+ * Values of the hardware performance counters (PMU).
+ *
+ * Not every counter may be available: inside a container, in a VM
+ * or with a restrictive /proc/sys/kernel/perf_event_paranoid the
+ * perf_event_open() syscall may fail. In that case the counter is
+ * marked as not valid and it is reported as "n/a".
+ * */
+struct PerfSample {
+    enum { CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, COUNT };
+
+    uint64_t values[COUNT] = {0};
+    bool valid[COUNT] = {false};
+
+    // Items processed (see PerfCounters::count_items())
+    uint64_t items = 0;
+
+    PerfSample operator-(const PerfSample& since) const {
+        PerfSample d;
+        for (int i = 0; i < COUNT; ++i) {
+            d.valid[i] = valid[i] and since.valid[i];
+            d.values[i] = d.valid[i] ? values[i] - since.values[i] : 0;
+        }
+        d.items = items - since.items;
+        return d;
+    }
+
+    PerfSample& operator+=(const PerfSample& other) {
+        for (int i = 0; i < COUNT; ++i) {
+            valid[i] = valid[i] or other.valid[i];
+            values[i] += other.values[i];
+        }
+        items += other.items;
+        return *this;
+    }
+};
+
+/*
+ * Hardware counters of the *calling* thread.
+ *
+ * The counters are opened with perf_event_open(pid=0, cpu=-1) and
+ * with inherit disabled, so they count only what *this* thread does
+ * (not the process and not the threads spawned by it) in user space.
+ *
+ * The object must be created, read and destroyed by the same thread.
+ * */
+class PerfCounters {
+    private:
+        int fds[PerfSample::COUNT];
+
+        static int open_counter(uint64_t config) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = config;
+            attr.inherit = 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            // pid 0 + cpu -1: this thread, in any cpu
+            return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        static uint64_t& items_counter() {
+            static thread_local uint64_t cnt = 0;
+            return cnt;
+        }
+
+        static PerfCounters*& current_ptr() {
+            static thread_local PerfCounters* current = nullptr;
+            return current;
+        }
+
+    public:
+        PerfCounters() {
+            const uint64_t configs[PerfSample::COUNT] = {
+                PERF_COUNT_HW_CPU_CYCLES,
+                PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES
+            };
+
+            for (int i = 0; i < PerfSample::COUNT; ++i) {
+                fds[i] = open_counter(configs[i]);
+            }
+
+            if (current_ptr() == nullptr) {
+                current_ptr() = this;
+            }
+        }
+
+        // True if at least one counter could be opened
+        bool available() const {
+            for (int i = 0; i < PerfSample::COUNT; ++i) {
+                if (fds[i] >= 0)
+                    return true;
+            }
+            return false;
+        }
+
+        PerfSample read() const {
+            PerfSample s;
+            for (int i = 0; i < PerfSample::COUNT; ++i) {
+                if (fds[i] < 0)
+                    continue;
+
+                uint64_t buf[3]; // value, time enabled, time running
+                if (::read(fds[i], buf, sizeof(buf)) != sizeof(buf))
+                    continue;
+
+                // If the kernel had to multiplex the PMU between more
+                // events than registers, the counter was running only
+                // a fraction of the time: scale it up.
+                if (buf[2] == 0)
+                    continue;
+
+                s.valid[i] = true;
+                s.values[i] = (buf[2] < buf[1]) ?
+                    (uint64_t)((double)buf[0] * buf[1] / buf[2]) : buf[0];
+            }
+
+            s.items = items_counter();
+            return s;
+        }
+
+        // The counters opened by Thread::main() for the calling thread
+        // or nullptr if the thread has no counters enabled.
+        static PerfCounters* current() {
+            return current_ptr();
+        }
+
+        // Count how many items (numbers, messages, rows, ...) the calling
+        // thread processed so the report can show the cost per item.
+        //
+        // It is a thread local counter: cheap enough to be called
+        // from the hot loop.
+        static void count_items(uint64_t n = 1) {
+            items_counter() += n;
+        }
+
+        ~PerfCounters() {
+            for (int i = 0; i < PerfSample::COUNT; ++i) {
+                if (fds[i] >= 0)
+                    close(fds[i]);
+            }
+
+            if (current_ptr() == this) {
+                current_ptr() = nullptr;
+            }
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+};
+
+/*
+ * Registry of the counters of the finished threads, one entry
+ * per thread and region. The whole run() of a thread is reported
+ * as the region "run".
+ * */
+class PerfRegistry {
+    private:
+        struct Entry {
+            std::string thread;
+            std::string region;
+            PerfSample sample;
+        };
+
+        std::mutex mtx;
+        std::vector<Entry> entries;
+
+        PerfRegistry() {}
+
+        static void print_value(std::ostream& out, int width,
+                                const PerfSample& s, int counter) {
+            if (s.valid[counter])
+                out << std::setw(width) << s.values[counter];
+            else
+                out << std::setw(width) << "n/a";
+        }
+
+        static void print_ratio(std::ostream& out, int width, bool valid,
+                                double num, double den) {
+            if (valid and den > 0)
+                out << std::setw(width) << std::fixed << std::setprecision(3) << num / den;
+            else
+                out << std::setw(width) << "n/a";
+        }
+
+    public:
+        static PerfRegistry& instance() {
+            static PerfRegistry registry;
+            return registry;
+        }
+
+        void add(const std::string& thread, const std::string& region,
+                 const PerfSample& sample) {
+            std::unique_lock<std::mutex> lck(mtx);
+            entries.push_back({thread, region, sample});
+        }
+
+        void clear() {
+            std::unique_lock<std::mutex> lck(mtx);
+            entries.clear();
+        }
+
+        size_t size() {
+            std::unique_lock<std::mutex> lck(mtx);
+            return entries.size();
+        }
+
+        void dump(std::ostream& out) {
+            std::unique_lock<std::mutex> lck(mtx);
+
+            out << std::left << std::setw(16) << "thread"
+                << std::setw(12) << "region"
+                << std::right
+                << std::setw(14) << "cycles"
+                << std::setw(14) << "instructions"
+                << std::setw(8) << "IPC"
+                << std::setw(12) << "LLC miss"
+                << std::setw(12) << "br miss"
+                << std::setw(10) << "items"
+                << std::setw(12) << "LLC/item"
+                << std::setw(12) << "br/item" << "\n";
+
+            for (const auto& e : entries) {
+                const PerfSample& s = e.sample;
+                out << std::left << std::setw(16) << e.thread
+                    << std::setw(12) << e.region << std::right;
+
+                print_value(out, 14, s, PerfSample::CYCLES);
+                print_value(out, 14, s, PerfSample::INSTRUCTIONS);
+                print_ratio(out, 8,
+                        s.valid[PerfSample::CYCLES] and s.valid[PerfSample::INSTRUCTIONS],
+                        s.values[PerfSample::INSTRUCTIONS], s.values[PerfSample::CYCLES]);
+                print_value(out, 12, s, PerfSample::LLC_MISSES);
+                print_value(out, 12, s, PerfSample::BRANCH_MISSES);
+                out << std::setw(10) << s.items;
+                print_ratio(out, 12, s.valid[PerfSample::LLC_MISSES],
+                        s.values[PerfSample::LLC_MISSES], s.items);
+                print_ratio(out, 12, s.valid[PerfSample::BRANCH_MISSES],
+                        s.values[PerfSample::BRANCH_MISSES], s.items);
+                out << "\n";
+            }
+        }
+
+        PerfRegistry(const PerfRegistry&) = delete;
+        PerfRegistry& operator=(const PerfRegistry&) = delete;
+};
+
+/*
+ * RAII object to measure a user-marked region of code of a thread
+ * that has the perf counters enabled (see Thread::enable_perf_counters())
+ *
+ *      {
+ *          PerfRegion region("parse");
+ *          ... code to measure ...
+ *      }
+ *
+ * The samples of the same region are accumulated and reported when
+ * the thread finishes. If the calling thread has no counters enabled
+ * this is a no-op.
+ * */
+class PerfRegion {
+    private:
+        PerfCounters* counters;
+        std::string name;
+        PerfSample begin;
+
+        static std::map<std::string, PerfSample>& accumulated() {
+            static thread_local std::map<std::string, PerfSample> regions;
+            return regions;
+        }
+
+    public:
+        explicit PerfRegion(const std::string& name) :
+            counters(PerfCounters::current()), name(name) {
+            if (counters)
+                begin = counters->read();
+        }
+
+        ~PerfRegion() {
+            if (counters)
+                accumulated()[name] += counters->read() - begin;
+        }
+
+        // Move the accumulated regions of the calling thread to the
+        // registry. Called by Thread::main() when the thread finishes.
+        static void flush(const std::string& thread) {
+            for (const auto& r : accumulated()) {
+                PerfRegistry::instance().add(thread, r.first, r.second);
+            }
+            accumulated().clear();
+        }
+
+        PerfRegion(const PerfRegion&) = delete;
+        PerfRegion& operator=(const PerfRegion&) = delete;
+};
+
+#endif
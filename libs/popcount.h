@@ -0,0 +1,249 @@
+#ifndef POPCOUNT_H_
+#define POPCOUNT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "cpu_features.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Count the bits set in an array of 64 bits words:
+ *
+ *      popcount_words(a, n)            bits set in a[0..n)
+ *      popcount_words_andnot(a, b, n)  bits set in a[i] & ~b[i]
+ *
+ * There is one version per instruction set; the best one supported by
+ * the CPU is used unless the caller asks for a specific one:
+ *
+ *  - AVX512_VPOPCNTDQ: one instruction counts 8 words (Ice Lake, Zen 4)
+ *  - AVX512BW and AVX2: nibble lookup table with vpshufb (W. Mula's
+ *    algorithm), 8 or 4 words at a time
+ *  - POPCNT: one popcnt instruction per word
+ *  - GENERIC: whatever the compiler does for __builtin_popcountll
+ *    without popcnt (a few shifts and masks per word)
+ *
+ * For large arrays all of them are limited by the memory bandwidth
+ * except GENERIC; the SIMD versions help when the words are in cache.
+ * */
+enum class PopcountImpl {
+    GENERIC,
+    POPCNT,
+    AVX2,
+    AVX512BW,
+    AVX512_VPOPCNTDQ
+};
+
+namespace popcount_detail {
+    template<bool ANDNOT>
+    inline uint64_t load(const uint64_t *a, const uint64_t *b, size_t i) {
+        return ANDNOT ? (a[i] & ~b[i]) : a[i];
+    }
+
+    template<bool ANDNOT>
+    inline uint64_t count_generic(const uint64_t *a, const uint64_t *b, size_t n) {
+        uint64_t cnt = 0;
+        for (size_t i = 0; i < n; ++i) {
+            cnt += __builtin_popcountll(load<ANDNOT>(a, b, i));
+        }
+        return cnt;
+    }
+
+#if defined(__x86_64__)
+    template<bool ANDNOT>
+    __attribute__((target("popcnt")))
+    inline uint64_t count_popcnt(const uint64_t *a, const uint64_t *b, size_t n) {
+        // Four independent accumulators: popcnt has a latency of 3 cycles
+        // but the CPU can start one per cycle
+        uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            c0 += __builtin_popcountll(load<ANDNOT>(a, b, i));
+            c1 += __builtin_popcountll(load<ANDNOT>(a, b, i+1));
+            c2 += __builtin_popcountll(load<ANDNOT>(a, b, i+2));
+            c3 += __builtin_popcountll(load<ANDNOT>(a, b, i+3));
+        }
+        for (; i < n; ++i) {
+            c0 += __builtin_popcountll(load<ANDNOT>(a, b, i));
+        }
+        return c0 + c1 + c2 + c3;
+    }
+
+    template<bool ANDNOT>
+    __attribute__((target("avx2,popcnt")))
+    inline uint64_t count_avx2(const uint64_t *a, const uint64_t *b, size_t n) {
+        const __m256i lookup = _mm256_setr_epi8(
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0f);
+        __m256i acc = _mm256_setzero_si256();
+
+        size_t i = 0;
+        while (i + 4 <= n) {
+            // Each byte of the local counter gets at most 8 per
+            // iteration: 31 iterations fit in a byte, then we widen
+            // them to 64 bits with vpsadbw
+            __m256i local = _mm256_setzero_si256();
+            for (int k = 0; k < 31 and i + 4 <= n; ++k, i += 4) {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(a + i));
+                if (ANDNOT) {
+                    v = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i*)(b + i)), v);
+                }
+                const __m256i lo = _mm256_and_si256(v, low_mask);
+                const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+                local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, lo));
+                local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, hi));
+            }
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(local, _mm256_setzero_si256()));
+        }
+
+        uint64_t cnt = (uint64_t)_mm256_extract_epi64(acc, 0) + (uint64_t)_mm256_extract_epi64(acc, 1)
+                     + (uint64_t)_mm256_extract_epi64(acc, 2) + (uint64_t)_mm256_extract_epi64(acc, 3);
+        for (; i < n; ++i) {
+            cnt += __builtin_popcountll(load<ANDNOT>(a, b, i));
+        }
+        return cnt;
+    }
+
+    // g++ 12 warns about "uninitialized" variables inside some of the
+    // AVX-512 intrinsics (_mm512_andnot_si512, _mm512_reduce_add_epi64)
+    // when they are used from a target() function; these two avoid them
+    __attribute__((target("avx512f")))
+    inline __m512i andnot512(__m512i a, __m512i b) {
+        return _mm512_and_si512(_mm512_xor_si512(a, _mm512_set1_epi64(-1)), b);
+    }
+
+    __attribute__((target("avx512f")))
+    inline uint64_t sum512(__m512i v) {
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512((void*)lanes, v);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+             + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    }
+
+    template<bool ANDNOT>
+    __attribute__((target("avx512f,avx512bw,popcnt")))
+    inline uint64_t count_avx512bw(const uint64_t *a, const uint64_t *b, size_t n) {
+        alignas(64) static const uint8_t table[64] = {
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+        const __m512i lookup = _mm512_load_si512((const void*)table);
+        const __m512i low_mask = _mm512_set1_epi8(0x0f);
+        __m512i acc = _mm512_setzero_si512();
+
+        size_t i = 0;
+        while (i + 8 <= n) {
+            __m512i local = _mm512_setzero_si512();
+            for (int k = 0; k < 31 and i + 8 <= n; ++k, i += 8) {
+                __m512i v = _mm512_loadu_si512((const void*)(a + i));
+                if (ANDNOT) {
+                    v = andnot512(_mm512_loadu_si512((const void*)(b + i)), v);
+                }
+                const __m512i lo = _mm512_and_si512(v, low_mask);
+                const __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+                local = _mm512_add_epi8(local, _mm512_shuffle_epi8(lookup, lo));
+                local = _mm512_add_epi8(local, _mm512_shuffle_epi8(lookup, hi));
+            }
+            acc = _mm512_add_epi64(acc, _mm512_sad_epu8(local, _mm512_setzero_si512()));
+        }
+
+        uint64_t cnt = sum512(acc);
+        for (; i < n; ++i) {
+            cnt += __builtin_popcountll(load<ANDNOT>(a, b, i));
+        }
+        return cnt;
+    }
+
+    template<bool ANDNOT>
+    __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+    inline uint64_t count_avx512_vpopcntdq(const uint64_t *a, const uint64_t *b, size_t n) {
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m512i v0 = _mm512_loadu_si512((const void*)(a + i));
+            __m512i v1 = _mm512_loadu_si512((const void*)(a + i + 8));
+            if (ANDNOT) {
+                v0 = andnot512(_mm512_loadu_si512((const void*)(b + i)), v0);
+                v1 = andnot512(_mm512_loadu_si512((const void*)(b + i + 8)), v1);
+            }
+            acc0 = _mm512_add_epi64(acc0, _mm512_popcnt_epi64(v0));
+            acc1 = _mm512_add_epi64(acc1, _mm512_popcnt_epi64(v1));
+        }
+
+        uint64_t cnt = sum512(_mm512_add_epi64(acc0, acc1));
+        for (; i < n; ++i) {
+            cnt += __builtin_popcountll(load<ANDNOT>(a, b, i));
+        }
+        return cnt;
+    }
+#endif
+
+    template<bool ANDNOT>
+    inline uint64_t count(const uint64_t *a, const uint64_t *b, size_t n, PopcountImpl impl) {
+        switch (impl) {
+#if defined(__x86_64__)
+            case PopcountImpl::AVX512_VPOPCNTDQ:
+                return count_avx512_vpopcntdq<ANDNOT>(a, b, n);
+            case PopcountImpl::AVX512BW:
+                return count_avx512bw<ANDNOT>(a, b, n);
+            case PopcountImpl::AVX2:
+                return count_avx2<ANDNOT>(a, b, n);
+            case PopcountImpl::POPCNT:
+                return count_popcnt<ANDNOT>(a, b, n);
+#endif
+            default:
+                return count_generic<ANDNOT>(a, b, n);
+        }
+    }
+}
+
+// The best implementation supported by this CPU
+inline PopcountImpl best_popcount_impl() {
+    const CpuFeatures& cpu = CpuFeatures::get();
+    if (cpu.avx512vpopcntdq) return PopcountImpl::AVX512_VPOPCNTDQ;
+    if (cpu.avx512bw) return PopcountImpl::AVX512BW;
+    if (cpu.avx2) return PopcountImpl::AVX2;
+    if (cpu.popcnt) return PopcountImpl::POPCNT;
+    return PopcountImpl::GENERIC;
+}
+
+// All the implementations that this CPU can run (for tests and benchmarks)
+inline std::vector<PopcountImpl> supported_popcount_impls() {
+    const CpuFeatures& cpu = CpuFeatures::get();
+    std::vector<PopcountImpl> impls = {PopcountImpl::GENERIC};
+    if (cpu.popcnt) impls.push_back(PopcountImpl::POPCNT);
+    if (cpu.avx2) impls.push_back(PopcountImpl::AVX2);
+    if (cpu.avx512bw) impls.push_back(PopcountImpl::AVX512BW);
+    if (cpu.avx512vpopcntdq) impls.push_back(PopcountImpl::AVX512_VPOPCNTDQ);
+    return impls;
+}
+
+inline const char* popcount_impl_name(PopcountImpl impl) {
+    switch (impl) {
+        case PopcountImpl::AVX512_VPOPCNTDQ: return "avx512vpopcntdq";
+        case PopcountImpl::AVX512BW: return "avx512bw";
+        case PopcountImpl::AVX2: return "avx2";
+        case PopcountImpl::POPCNT: return "popcnt";
+        default: return "generic";
+    }
+}
+
+inline uint64_t popcount_words(const uint64_t *a, size_t n,
+                               PopcountImpl impl = best_popcount_impl()) {
+    return popcount_detail::count<false>(a, nullptr, n, impl);
+}
+
+inline uint64_t popcount_words_andnot(const uint64_t *a, const uint64_t *b, size_t n,
+                                      PopcountImpl impl = best_popcount_impl()) {
+    return popcount_detail::count<true>(a, b, n, impl);
+}
+
+#endif
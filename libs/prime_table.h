@@ -0,0 +1,144 @@
+#ifndef PRIME_TABLE_H_
+#define PRIME_TABLE_H_
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * The primes below PRIME_TABLE_BOUND, computed by the compiler.
+ *
+ * The nums of 01..03 have 0, 1, 2, 4 and 13: tiny numbers that still go
+ * through the loop of IsPrime::run. Here a sieve of Eratosthenes runs
+ * at compile time (constexpr) and its result is embedded in the binary
+ * as read only data:
+ *
+ *  - a bitmap of the odd numbers below the bound (bit i is 2*i + 1):
+ *    PrimeTable::is_prime(n) is a shift and a mask, O(1)
+ *  - the list of the primes below the bound, in order: the divisors for
+ *    a trial division (all the divisors of a 32 bits number are below
+ *    2^16)
+ *
+ * Nothing runs at startup and there is no lazy initialization to check
+ * on each call. The price is paid by the compiler: the default 2^16
+ * adds ~0.3 s to the build of each translation unit that includes this
+ * header and 2^20 adds ~5 s. Beyond 2^20, g++ needs larger
+ * -fconstexpr-ops-limit and -fconstexpr-loop-limit.
+ *
+ *      static_assert(PrimeTable::is_prime(65521));
+ *      if (PrimeTable::contains(n)) return PrimeTable::is_prime(n);
+ * */
+#ifndef PRIME_TABLE_BOUND
+#define PRIME_TABLE_BOUND (1 << 16)
+#endif
+
+namespace prime_table_detail {
+    const uint32_t BOUND = PRIME_TABLE_BOUND;
+    const size_t WORDS = (BOUND / 2 + 63) / 64;
+
+    static_assert(BOUND >= 64, "PRIME_TABLE_BOUND must be at least 64");
+
+    // Plain arrays and no std::array::operator[]: each call counts
+    // against the compiler's limit of constexpr operations
+    struct Bitmap {
+        uint64_t words[WORDS];
+    };
+
+    template<size_t N>
+    struct Primes {
+        uint32_t values[N];
+    };
+
+    constexpr bool test(const Bitmap& bits, uint64_t b) {
+        return bits.words[b / 64] & (uint64_t(1) << (b % 64));
+    }
+
+    constexpr Bitmap sieve() {
+        Bitmap bits{};
+        for (size_t w = 0; w < WORDS; ++w) {
+            bits.words[w] = ~uint64_t(0);
+        }
+        bits.words[0] &= ~uint64_t(1); // 1 is not a prime
+
+        // The odd multiples of p are p bits apart
+        for (uint64_t p = 3; p * p < BOUND; p += 2) {
+            if (not test(bits, p / 2)) {
+                continue;
+            }
+            for (uint64_t b = p * p / 2; b < BOUND / 2; b += p) {
+                bits.words[b / 64] &= ~(uint64_t(1) << (b % 64));
+            }
+        }
+
+        // Clear the bits of the last word beyond the bound
+        const uint64_t nbits = BOUND / 2;
+        if (nbits % 64) {
+            bits.words[WORDS - 1] &= (uint64_t(1) << (nbits % 64)) - 1;
+        }
+        return bits;
+    }
+
+    inline constexpr Bitmap BITMAP = sieve();
+
+    constexpr size_t count_primes() {
+        size_t cnt = 1; // the 2
+        for (size_t w = 0; w < WORDS; ++w) {
+            cnt += __builtin_popcountll(BITMAP.words[w]);
+        }
+        return cnt;
+    }
+
+    inline constexpr size_t PRIMES_CNT = count_primes();
+
+    constexpr Primes<PRIMES_CNT> list_primes() {
+        Primes<PRIMES_CNT> primes{};
+        size_t i = 0;
+        primes.values[i++] = 2;
+        // Word by word: g++ limits the iterations of a constexpr loop
+        for (size_t w = 0; w < WORDS; ++w) {
+            for (uint64_t word = BITMAP.words[w]; word; word &= word - 1) {
+                primes.values[i++] = 2 * (w * 64 + __builtin_ctzll(word)) + 1;
+            }
+        }
+        return primes;
+    }
+
+    inline constexpr Primes<PRIMES_CNT> PRIMES = list_primes();
+}
+
+struct PrimeTable {
+    // The table covers [0, bound)
+    static constexpr uint32_t bound = prime_table_detail::BOUND;
+
+    static constexpr bool contains(uint64_t n) {
+        return n < bound;
+    }
+
+    // n must be below the bound (see contains())
+    static constexpr bool is_prime(uint64_t n) {
+        if (n % 2 == 0) {
+            return n == 2;
+        }
+        return prime_table_detail::test(prime_table_detail::BITMAP, n / 2);
+    }
+
+    // How many primes are below the bound
+    static constexpr size_t count() {
+        return prime_table_detail::PRIMES_CNT;
+    }
+
+    // The i-th prime, from prime(0) == 2
+    static constexpr uint32_t prime(size_t i) {
+        return prime_table_detail::PRIMES.values[i];
+    }
+
+    // All the primes below the bound, in order
+    static constexpr const uint32_t* begin() {
+        return prime_table_detail::PRIMES.values;
+    }
+
+    static constexpr const uint32_t* end() {
+        return prime_table_detail::PRIMES.values + prime_table_detail::PRIMES_CNT;
+    }
+};
+
+#endif
@@ -8,6 +8,8 @@
 #include <climits>
 #include <stdexcept>
 
+#include "thread_stats.h"
+
 struct ClosedQueue : public std::runtime_error {
     ClosedQueue() : std::runtime_error("The queue is closed") {}
 };
@@ -87,6 +89,7 @@ class Queue {
             }
 
 	    while (q.size() == this->max_size) {
+		ThreadStats::on_blocked();
 		is_not_full.wait(lck);
 	    }
 
@@ -105,6 +108,7 @@ class Queue {
                 if (closed) {
                     throw ClosedQueue();
                 }
+                ThreadStats::on_blocked();
                 is_not_empty.wait(lck);
             }
 
@@ -197,6 +201,7 @@ class Queue<void*> {
             }
 
 	    while (q.size() == this->max_size) {
+		ThreadStats::on_blocked();
 		is_not_full.wait(lck);
 	    }
 
@@ -215,6 +220,7 @@ class Queue<void*> {
                 if (closed) {
                     throw ClosedQueue();
                 }
+                ThreadStats::on_blocked();
                 is_not_empty.wait(lck);
             }
 
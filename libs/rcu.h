@@ -0,0 +1,233 @@
+#ifndef RCU_H_
+#define RCU_H_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+
+#include "cache_line.h"
+
+/*
+ * Read-copy-update (RCU) snapshots.
+ *
+ * A Monitor makes the readers and the writers wait for each other:
+ * a long report like Attendance::print of 13_fixme.cpp holds the lock
+ * for the whole walk and all the writers stall behind it.
+ *
+ * With Rcu<T> the readers never lock and never make the writers wait:
+ *
+ *  - the current version of T is behind an atomic pointer; a reader
+ *    takes it and reads that version for as long as it wants. Nobody
+ *    will modify it: it is an immutable snapshot
+ *  - a writer copies the current version, modifies the copy and
+ *    publishes it swapping the pointer ("read-copy-update"). The
+ *    writers are serialized among them by a mutex
+ *  - the old version cannot be deleted right away: a reader may still
+ *    be reading it. It is "retired" and deleted later, when all the
+ *    readers that could have seen it left (epoch based reclamation)
+ *
+ *      Rcu<Attendance> list;
+ *
+ *      list.update([id](Attendance& l) { ... });   // a writer
+ *
+ *      auto snapshot = list.read();                 // a reader
+ *      snapshot->print(std::cout);
+ *
+ * Each update copies the whole T so it is not for a T that changes a
+ * lot and that it is expensive to copy: a writer should apply many
+ * changes in a single update() (batching) or use a T that shares
+ * structure between versions.
+ *
+ * Epochs: there is a global epoch counter; a reader announces the epoch
+ * that it saw when it started in its own slot (one cache line per slot)
+ * and clears it when it leaves. A version retired at epoch E can be
+ * deleted once all the announced epochs are greater than E.
+ *
+ * There are up to READERS readers at the same time; more readers will
+ * wait (yielding) for a free slot.
+ * */
+template<typename T, size_t READERS = 64>
+class Rcu {
+    private:
+        struct alignas(CACHE_LINE_SIZE) ReaderSlot {
+            // 0 means "not reading"
+            std::atomic<uint64_t> epoch;
+            ReaderSlot() : epoch(0) {}
+        };
+
+        struct Retired {
+            const T *version;
+            uint64_t epoch;
+        };
+
+        std::atomic<const T*> current;
+        std::atomic<uint64_t> global_epoch;
+        ReaderSlot readers[READERS];
+
+        std::mutex writers_mtx;
+        std::vector<Retired> retired;
+
+        // Each thread starts looking for a free slot in a different
+        // place so the readers do not fight for the same one
+        static size_t slot_hint() {
+            static std::atomic<size_t> next(0);
+            static thread_local size_t hint = next.fetch_add(1, std::memory_order_relaxed);
+            return hint;
+        }
+
+        ReaderSlot* enter() {
+            const size_t first = slot_hint();
+            while (true) {
+                for (size_t i = 0; i < READERS; ++i) {
+                    ReaderSlot& slot = readers[(first + i) % READERS];
+                    uint64_t idle = 0;
+                    const uint64_t e = global_epoch.load();
+                    if (slot.epoch.compare_exchange_strong(idle, e)) {
+                        return &slot;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        // Delete the retired versions that no reader can see.
+        // Must be called with the writers' lock taken.
+        void reclaim() {
+            uint64_t min_epoch = UINT64_MAX;
+            for (size_t i = 0; i < READERS; ++i) {
+                const uint64_t e = readers[i].epoch.load();
+                if (e != 0 and e < min_epoch) {
+                    min_epoch = e;
+                }
+            }
+
+            size_t kept = 0;
+            for (size_t i = 0; i < retired.size(); ++i) {
+                if (retired[i].epoch < min_epoch) {
+                    delete retired[i].version;
+                } else {
+                    retired[kept++] = retired[i];
+                }
+            }
+            retired.resize(kept);
+        }
+
+        // Must be called with the writers' lock taken.
+        void publish_locked(const T *version) {
+            const T *old = current.exchange(version);
+
+            // A reader that announces an epoch greater than this one
+            // did it after the exchange so it will see the new version
+            const uint64_t e = global_epoch.fetch_add(1);
+            retired.push_back(Retired{old, e});
+
+            reclaim();
+        }
+
+    public:
+        /*
+         * A snapshot being read. While it is alive the version that it
+         * points to is not deleted; release it as soon as possible
+         * (a forgotten Snapshot makes the retired versions pile up).
+         * */
+        class Snapshot {
+            private:
+                ReaderSlot *slot;
+                const T *version;
+
+                friend class Rcu;
+                Snapshot(ReaderSlot *slot, const T *version) : slot(slot), version(version) {}
+
+            public:
+                Snapshot(Snapshot&& other) : slot(other.slot), version(other.version) {
+                    other.slot = nullptr;
+                    other.version = nullptr;
+                }
+
+                const T& operator*() const {
+                    return *version;
+                }
+
+                const T* operator->() const {
+                    return version;
+                }
+
+                void release() {
+                    if (slot) {
+                        slot->epoch.store(0, std::memory_order_release);
+                        slot = nullptr;
+                        version = nullptr;
+                    }
+                }
+
+                ~Snapshot() {
+                    release();
+                }
+
+                Snapshot(const Snapshot&) = delete;
+                Snapshot& operator=(const Snapshot&) = delete;
+                Snapshot& operator=(Snapshot&&) = delete;
+        };
+
+        template<typename... Args>
+        explicit Rcu(Args&&... args) :
+            current(new T(std::forward<Args>(args)...)), global_epoch(1) {}
+
+        // Lock-free for the caller as long as there is a free slot.
+        Snapshot read() {
+            ReaderSlot *slot = enter();
+            // The epoch is announced before loading the pointer
+            // (both are seq_cst): see publish_locked()
+            return Snapshot(slot, current.load());
+        }
+
+        // Copy the current version, call f(copy) and publish the copy.
+        // Returns what f returns.
+        template<class F>
+        auto update(F f) {
+            std::unique_lock<std::mutex> lck(writers_mtx);
+
+            std::unique_ptr<T> copy(new T(*current.load(std::memory_order_relaxed)));
+
+            // If f throws, the copy is discarded and nothing is published
+            if constexpr (std::is_void<decltype(f(*copy))>::value) {
+                f(*copy);
+                publish_locked(copy.release());
+            } else {
+                auto result = f(*copy);
+                publish_locked(copy.release());
+                return result;
+            }
+        }
+
+        // Replace the current version by a new one.
+        void publish(std::unique_ptr<T> version) {
+            std::unique_lock<std::mutex> lck(writers_mtx);
+            publish_locked(version.release());
+        }
+
+        // Versions retired but not deleted yet (for tests and stats)
+        size_t retired_count() {
+            std::unique_lock<std::mutex> lck(writers_mtx);
+            reclaim();
+            return retired.size();
+        }
+
+        // There must be no Snapshot alive
+        ~Rcu() {
+            for (const Retired& r : retired) {
+                delete r.version;
+            }
+            delete current.load();
+        }
+
+        Rcu(const Rcu&) = delete;
+        Rcu& operator=(const Rcu&) = delete;
+};
+
+#endif
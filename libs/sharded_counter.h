@@ -0,0 +1,94 @@
+#ifndef SHARDED_COUNTER_H_
+#define SHARDED_COUNTER_H_
+
+#include <sched.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "cache_line.h"
+
+/*
+ * A counter for many writers and few readers.
+ *
+ * ResultProtected (07_sumatoria_with_monitor.cpp) takes a mutex on
+ * each inc(): with a lot of threads, they spend more time waiting
+ * for the mutex than incrementing. A single std::atomic is better but
+ * all the threads still fight for the same cache line.
+ *
+ * Here the counter is split in slots, each in its own cache line.
+ * A thread increments only "its" slot with a relaxed fetch_add and
+ * get_val() sums all the slots. Writers don't contend (or contend
+ * rarely) and the reader pays the cost.
+ *
+ * The slot of a thread can be chosen by:
+ *
+ *  - BY_THREAD: each thread gets a slot the first time that it
+ *    increments any ShardedCounter (round robin). Cheap, but two
+ *    threads may share a slot if there are more threads than slots.
+ *  - BY_CPU: the slot of the CPU where the thread is running
+ *    (sched_getcpu()). Threads that run in the same CPU share the
+ *    slot but they cannot run at the same time so they barely contend.
+ *
+ * get_val() is not a snapshot: increments done while it runs may be
+ * counted or not. Once the writers stopped, it is exact.
+ * */
+template<typename T = unsigned long>
+class ShardedCounter {
+    public:
+        enum Sharding { BY_THREAD, BY_CPU };
+
+    private:
+        std::unique_ptr<CacheAligned<std::atomic<T> >[]> slots;
+        const size_t mask;
+        const Sharding sharding;
+
+        static size_t round_up_pow2(size_t n) {
+            size_t p = 1;
+            while (p < n) {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        static size_t thread_index() {
+            static std::atomic<size_t> next(0);
+            static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+            return index;
+        }
+
+        size_t slot() const {
+            if (sharding == BY_CPU) {
+                int cpu = sched_getcpu();
+                return cpu < 0 ? thread_index() & mask : (size_t)cpu & mask;
+            }
+            return thread_index() & mask;
+        }
+
+    public:
+        explicit ShardedCounter(T v = 0, Sharding sharding = BY_THREAD,
+                                size_t slots_cnt = 2 * std::thread::hardware_concurrency()) :
+            slots(new CacheAligned<std::atomic<T> >[round_up_pow2(slots_cnt ? slots_cnt : 1)]),
+            mask(round_up_pow2(slots_cnt ? slots_cnt : 1) - 1),
+            sharding(sharding) {
+            slots[0].value.store(v, std::memory_order_relaxed);
+        }
+
+        void inc(T s) {
+            slots[slot()].value.fetch_add(s, std::memory_order_relaxed);
+        }
+
+        T get_val() const {
+            T sum = 0;
+            for (size_t i = 0; i <= mask; ++i) {
+                sum += slots[i].value.load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+
+        ShardedCounter(const ShardedCounter&) = delete;
+        ShardedCounter& operator=(const ShardedCounter&) = delete;
+};
+
+#endif
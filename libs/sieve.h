@@ -0,0 +1,270 @@
+#ifndef SIEVE_H_
+#define SIEVE_H_
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "thread_pool.h"
+#include "cache_line.h"
+#include "popcount.h"
+#include "prime_table.h"
+#include "int_math.h"
+
+/*
+ * Segmented sieve of Eratosthenes, in parallel.
+ *
+ * IsPrime in 01..03 does a trial division by all the numbers from 2
+ * to n: O(n) per number and it starts from scratch for each number.
+ * When we want to know the primes of a whole range it is much cheaper
+ * to sieve the range once: O(n log log n) for all of them together.
+ *
+ *  - only the odd numbers are stored, one bit each (1 means prime):
+ *    the bit i is the number 2*i + 1, so 1e9 numbers take 62.5 MB
+ *  - the range is split in segments of SIEVE_SEGMENT_BYTES (the size
+ *    of a L1 data cache): a segment is crossed off by all the primes
+ *    up to sqrt(n) while it is still in the cache ("cache blocking")
+ *  - the segments are split in a few chunks per thread of the pool and
+ *    sieved in parallel. Each chunk writes its own words: there is no
+ *    lock and no atomic
+ *
+ * PrimeSieve keeps the bits of [0, limit] and answers is_prime() and
+ * count_primes() in O(1) and O(range / 64). count_primes(lo, hi) alone
+ * sieves the segments without keeping them, for ranges that do not fit
+ * in memory.
+ * */
+#ifndef SIEVE_SEGMENT_BYTES
+#define SIEVE_SEGMENT_BYTES (32 * 1024)
+#endif
+
+namespace sieve_detail {
+    const uint64_t SEGMENT_BITS = SIEVE_SEGMENT_BYTES * 8;
+
+    // The odd primes up to limit (limit is ~sqrt(n)): from the compile
+    // time table if it is large enough, otherwise a plain sieve
+    inline std::vector<uint32_t> odd_primes_up_to(uint64_t limit) {
+        if (PrimeTable::contains(limit)) {
+            return std::vector<uint32_t>(PrimeTable::begin() + 1,
+                    std::upper_bound(PrimeTable::begin(), PrimeTable::end(), limit));
+        }
+
+        std::vector<bool> composite(limit + 1, false);
+        std::vector<uint32_t> primes;
+        for (uint64_t i = 3; i <= limit; i += 2) {
+            if (composite[i]) {
+                continue;
+            }
+            primes.push_back(i);
+            for (uint64_t j = i * i; j <= limit; j += 2 * i) {
+                composite[j] = true;
+            }
+        }
+        return primes;
+    }
+
+    /*
+     * Sieve the bits [first_bit, first_bit + nbits) (the odd numbers
+     * from 2*first_bit + 1) into words[0..]. first_bit must be a
+     * multiple of 64; the bits after nbits in the last word are cleared.
+     * */
+    inline void sieve_segment(uint64_t *words, uint64_t first_bit, uint64_t nbits,
+                              const std::vector<uint32_t>& primes) {
+        const uint64_t nwords = (nbits + 63) / 64;
+        std::fill(words, words + nwords, ~uint64_t(0));
+
+        if (first_bit == 0) {
+            words[0] &= ~uint64_t(1); // 1 is not a prime
+        }
+
+        const uint64_t lo = 2 * first_bit + 1;
+        const uint64_t hi = 2 * (first_bit + nbits) - 1; // last odd number
+
+        for (uint64_t p : primes) {
+            uint64_t m = p * p;
+            if (m > hi) {
+                break;
+            }
+
+            if (m < lo) {
+                m = (lo + p - 1) / p * p;
+                if (m % 2 == 0) {
+                    m += p;
+                }
+            }
+
+            // The odd multiples of p are p bits apart
+            for (uint64_t b = (m - 1) / 2 - first_bit; b < nbits; b += p) {
+                words[b / 64] &= ~(uint64_t(1) << (b % 64));
+            }
+        }
+
+        if (nbits % 64) {
+            words[nwords - 1] &= (uint64_t(1) << (nbits % 64)) - 1;
+        }
+    }
+
+    // Bits set in [b0, b1) of words
+    inline uint64_t count_bits(const uint64_t *words, uint64_t b0, uint64_t b1) {
+        if (b0 >= b1) {
+            return 0;
+        }
+
+        const uint64_t w0 = b0 / 64;
+        const uint64_t w1 = (b1 - 1) / 64;
+        const uint64_t head = ~uint64_t(0) << (b0 % 64);
+        const uint64_t tail = ~uint64_t(0) >> (63 - (b1 - 1) % 64);
+
+        if (w0 == w1) {
+            return __builtin_popcountll(words[w0] & head & tail);
+        }
+
+        return __builtin_popcountll(words[w0] & head)
+             + popcount_words(words + w0 + 1, w1 - w0 - 1)
+             + __builtin_popcountll(words[w1] & tail);
+    }
+
+    /*
+     * Split the segments of the bits [first_bit, last_bit) in chunks and call
+     * f(chunk, first_bit, nbits_of_the_segment) for each segment, in
+     * parallel among the chunks and in order within a chunk.
+     * Return the number of chunks.
+     * */
+    template<class F>
+    size_t for_each_segment(uint64_t first_bit, uint64_t last_bit, ThreadPool& pool, F f) {
+        const uint64_t segments = (last_bit - first_bit + SEGMENT_BITS - 1) / SEGMENT_BITS;
+        const size_t chunks = std::max<uint64_t>(1, std::min<uint64_t>(segments, (uint64_t)pool.size() * 4));
+
+        auto run_chunk = [=](size_t c) {
+            for (uint64_t s = segments * c / chunks; s < segments * (c+1) / chunks; ++s) {
+                const uint64_t b = first_bit + s * SEGMENT_BITS;
+                f(c, b, std::min(SEGMENT_BITS, last_bit - b));
+            }
+        };
+
+        if (chunks == 1) {
+            run_chunk(0);
+            return 1;
+        }
+
+        TaskGroup group(pool);
+        for (size_t c = 0; c < chunks; ++c) {
+            group.run([&run_chunk, c]() { run_chunk(c); });
+        }
+        group.wait();
+        return chunks;
+    }
+}
+
+class PrimeSieve {
+    private:
+        uint64_t max_n;
+        std::vector<uint64_t> bits;
+
+    public:
+        // Sieve [0, limit]
+        explicit PrimeSieve(uint64_t limit, ThreadPool& pool = ThreadPool::instance()) :
+            max_n(limit),
+            bits(((limit + 1) / 2 + 63) / 64 + 1, 0) {
+            using namespace sieve_detail;
+
+            const std::vector<uint32_t> primes = odd_primes_up_to(isqrt(limit));
+            const uint64_t nbits = (limit + 1) / 2;
+            uint64_t *words = bits.data();
+
+            // Each segment starts at a multiple of SEGMENT_BITS (and so
+            // of 64): the chunks never write to the same word
+            for_each_segment(0, nbits, pool, [words, &primes](size_t, uint64_t b, uint64_t n) {
+                sieve_segment(words + b / 64, b, n, primes);
+            });
+        }
+
+        uint64_t limit() const {
+            return max_n;
+        }
+
+        bool is_prime(uint64_t n) const {
+            if (n > max_n) {
+                throw std::out_of_range("The number is beyond the sieve's limit");
+            }
+            if (n % 2 == 0) {
+                return n == 2;
+            }
+            return bits[n / 128] & (uint64_t(1) << ((n / 2) % 64));
+        }
+
+        // Primes in [lo, hi) with hi <= limit + 1
+        uint64_t count_primes(uint64_t lo, uint64_t hi) const {
+            if (hi > max_n + 1) {
+                throw std::out_of_range("The range is beyond the sieve's limit");
+            }
+            if (lo >= hi) {
+                return 0;
+            }
+
+            const uint64_t two = (lo <= 2 and 2 < hi) ? 1 : 0;
+            return two + sieve_detail::count_bits(bits.data(), lo / 2, hi / 2);
+        }
+
+        // Call f(p) for each prime p in [lo, hi), in order
+        template<class F>
+        void for_each_prime(uint64_t lo, uint64_t hi, F f) const {
+            hi = std::min(hi, max_n + 1);
+            if (lo <= 2 and 2 < hi) {
+                f(uint64_t(2));
+            }
+
+            const uint64_t b0 = lo / 2;
+            const uint64_t b1 = hi / 2;
+            for (uint64_t w = b0 / 64; w * 64 < b1; ++w) {
+                uint64_t word = bits[w];
+                while (word) {
+                    const uint64_t b = w * 64 + __builtin_ctzll(word);
+                    word &= word - 1;
+                    if (b >= b0 and b < b1) {
+                        f(2 * b + 1);
+                    }
+                }
+            }
+        }
+};
+
+/*
+ * Count the primes in [lo, hi) without keeping the sieve: each chunk
+ * reuses a single segment buffer so the memory is one segment per
+ * chunk, whatever the size of the range.
+ * */
+inline uint64_t count_primes(uint64_t lo, uint64_t hi, ThreadPool& pool = ThreadPool::instance()) {
+    using namespace sieve_detail;
+
+    if (lo >= hi) {
+        return 0;
+    }
+
+    const std::vector<uint32_t> primes = odd_primes_up_to(isqrt(hi));
+    const uint64_t b0 = lo / 2;
+    const uint64_t b1 = hi / 2;
+    const uint64_t first_bit = b0 / 64 * 64;
+
+    // At least 1: a pool of 0 workers sieves everything in the caller
+    const size_t max_chunks = std::max<size_t>(1, (size_t)pool.size() * 4);
+    std::vector<CacheAligned<uint64_t> > counts(max_chunks, CacheAligned<uint64_t>(0));
+    std::vector<std::vector<uint64_t> > buffers(max_chunks);
+
+    const size_t chunks = for_each_segment(first_bit, b1, pool,
+            [&](size_t c, uint64_t b, uint64_t n) {
+        std::vector<uint64_t>& words = buffers[c];
+        words.resize(SEGMENT_BITS / 64);
+
+        sieve_segment(words.data(), b, n, primes);
+        counts[c].value += count_bits(words.data(), std::max(b0, b) - b, n);
+    });
+
+    uint64_t total = (lo <= 2 and 2 < hi) ? 1 : 0;
+    for (size_t c = 0; c < chunks; ++c) {
+        total += counts[c].value;
+    }
+    return total;
+}
+
+#endif
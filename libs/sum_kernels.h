@@ -0,0 +1,287 @@
+#ifndef SUM_KERNELS_H_
+#define SUM_KERNELS_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <numeric>
+
+#include "cpu_features.h"
+#include "parallel.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Sum of an array, the per-chunk work of a parallel sum.
+ *
+ * Sum::run in 04..07 adds unsigned ints one at a time into an unsigned
+ * int: it overflows silently and it does one addition per cycle at
+ * best. Here:
+ *
+ *      uint64_t sum_array(const uint32_t *a, size_t n)
+ *      uint64_t sum_array(const uint64_t *a, size_t n)   modulo 2^64
+ *      double   sum_array(const float *a, size_t n)
+ *
+ *  - the accumulators are wider than the elements: the uint32_t are
+ *    added in 64 bits lanes (no overflow until 2^32 elements of
+ *    UINT32_MAX) and the floats in doubles (far less rounding)
+ *  - there are 4 independent accumulators: an addition does not wait
+ *    for the previous one (a vector add has a latency of 1 cycle for
+ *    integers and 4 for doubles, and the CPU can start 2 per cycle)
+ *  - one version per instruction set, GENERIC, AVX2 and AVX512, picked
+ *    at runtime (cpu_features.h) unless the caller asks for one
+ *
+ * parallel_sum(a, n) splits the array among the threads of the pool
+ * with parallel_reduce (parallel.h) and runs sum_array on each chunk.
+ *
+ * Once the array does not fit in the caches all the versions are
+ * limited by the memory bandwidth; the vector ones shine when it does.
+ * */
+enum class SumImpl {
+    GENERIC,
+    AVX2,
+    AVX512
+};
+
+namespace sum_kernels_detail {
+    // Scalar: the compiler may vectorize it (with SSE2 at most, the
+    // baseline of x86-64) but without the widening of the floats
+    template<typename T, typename Acc>
+    inline Acc sum_generic(const T *a, size_t n) {
+        Acc s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            s0 += a[i];
+            s1 += a[i+1];
+            s2 += a[i+2];
+            s3 += a[i+3];
+        }
+        for (; i < n; ++i) {
+            s0 += a[i];
+        }
+        return (s0 + s1) + (s2 + s3);
+    }
+
+#if defined(__x86_64__)
+    // Store and add the lanes: this avoids the warnings of g++ 12 about
+    // the _mm512_reduce_* intrinsics (see popcount.h)
+    __attribute__((target("avx2")))
+    inline uint64_t lanes_u64(__m256i v) {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256((__m256i*)lanes, v);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    __attribute__((target("avx2")))
+    inline double lanes_f64(__m256d v) {
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, v);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    __attribute__((target("avx512f")))
+    inline uint64_t lanes_u64(__m512i v) {
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512((void*)lanes, v);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+             + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    }
+
+    __attribute__((target("avx512f")))
+    inline double lanes_f64(__m512d v) {
+        alignas(64) double lanes[8];
+        _mm512_store_pd(lanes, v);
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]))
+             + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+
+    // 16 uint32_t per iteration, widened to 4 accumulators of 4 x 64 bits.
+    // Seen as 64 bits lanes, v & 0xffffffff are the even uint32_t and
+    // v >> 32 the odd ones: a widening without any shuffle
+    __attribute__((target("avx2")))
+    inline uint64_t sum_u32_avx2(const uint32_t *a, size_t n) {
+        const __m256i low = _mm256_set1_epi64x(0xffffffff);
+        __m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const __m256i v0 = _mm256_loadu_si256((const __m256i*)(a + i));
+            const __m256i v1 = _mm256_loadu_si256((const __m256i*)(a + i + 8));
+            s0 = _mm256_add_epi64(s0, _mm256_and_si256(v0, low));
+            s1 = _mm256_add_epi64(s1, _mm256_srli_epi64(v0, 32));
+            s2 = _mm256_add_epi64(s2, _mm256_and_si256(v1, low));
+            s3 = _mm256_add_epi64(s3, _mm256_srli_epi64(v1, 32));
+        }
+        uint64_t s = lanes_u64(_mm256_add_epi64(_mm256_add_epi64(s0, s1), _mm256_add_epi64(s2, s3)));
+        return s + sum_generic<uint32_t, uint64_t>(a + i, n - i);
+    }
+
+    __attribute__((target("avx2")))
+    inline uint64_t sum_u64_avx2(const uint64_t *a, size_t n) {
+        __m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            s0 = _mm256_add_epi64(s0, _mm256_loadu_si256((const __m256i*)(a + i)));
+            s1 = _mm256_add_epi64(s1, _mm256_loadu_si256((const __m256i*)(a + i + 4)));
+            s2 = _mm256_add_epi64(s2, _mm256_loadu_si256((const __m256i*)(a + i + 8)));
+            s3 = _mm256_add_epi64(s3, _mm256_loadu_si256((const __m256i*)(a + i + 12)));
+        }
+        uint64_t s = lanes_u64(_mm256_add_epi64(_mm256_add_epi64(s0, s1), _mm256_add_epi64(s2, s3)));
+        return s + sum_generic<uint64_t, uint64_t>(a + i, n - i);
+    }
+
+    __attribute__((target("avx2")))
+    inline double sum_f32_avx2(const float *a, size_t n) {
+        __m256d s0 = _mm256_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm_loadu_ps(a + i)));
+            s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm_loadu_ps(a + i + 4)));
+            s2 = _mm256_add_pd(s2, _mm256_cvtps_pd(_mm_loadu_ps(a + i + 8)));
+            s3 = _mm256_add_pd(s3, _mm256_cvtps_pd(_mm_loadu_ps(a + i + 12)));
+        }
+        double s = lanes_f64(_mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3)));
+        return s + sum_generic<float, double>(a + i, n - i);
+    }
+
+    // g++ 12 also warns about _mm512_srli_epi64 and _mm512_cvtps_pd; their
+    // "maskz" versions with all the lanes selected are the same instruction
+    const __mmask8 ALL8 = 0xff;
+
+    // 32 uint32_t per iteration, widened to 4 accumulators of 8 x 64 bits
+    __attribute__((target("avx512f")))
+    inline uint64_t sum_u32_avx512(const uint32_t *a, size_t n) {
+        const __m512i low = _mm512_set1_epi64(0xffffffff);
+        __m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            const __m512i v0 = _mm512_loadu_si512((const void*)(a + i));
+            const __m512i v1 = _mm512_loadu_si512((const void*)(a + i + 16));
+            s0 = _mm512_add_epi64(s0, _mm512_and_si512(v0, low));
+            s1 = _mm512_add_epi64(s1, _mm512_maskz_srli_epi64(ALL8, v0, 32));
+            s2 = _mm512_add_epi64(s2, _mm512_and_si512(v1, low));
+            s3 = _mm512_add_epi64(s3, _mm512_maskz_srli_epi64(ALL8, v1, 32));
+        }
+        uint64_t s = lanes_u64(_mm512_add_epi64(_mm512_add_epi64(s0, s1), _mm512_add_epi64(s2, s3)));
+        return s + sum_generic<uint32_t, uint64_t>(a + i, n - i);
+    }
+
+    __attribute__((target("avx512f")))
+    inline uint64_t sum_u64_avx512(const uint64_t *a, size_t n) {
+        __m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            s0 = _mm512_add_epi64(s0, _mm512_loadu_si512((const void*)(a + i)));
+            s1 = _mm512_add_epi64(s1, _mm512_loadu_si512((const void*)(a + i + 8)));
+            s2 = _mm512_add_epi64(s2, _mm512_loadu_si512((const void*)(a + i + 16)));
+            s3 = _mm512_add_epi64(s3, _mm512_loadu_si512((const void*)(a + i + 24)));
+        }
+        uint64_t s = lanes_u64(_mm512_add_epi64(_mm512_add_epi64(s0, s1), _mm512_add_epi64(s2, s3)));
+        return s + sum_generic<uint64_t, uint64_t>(a + i, n - i);
+    }
+
+    __attribute__((target("avx512f")))
+    inline double sum_f32_avx512(const float *a, size_t n) {
+        __m512d s0 = _mm512_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            s0 = _mm512_add_pd(s0, _mm512_maskz_cvtps_pd(ALL8, _mm256_loadu_ps(a + i)));
+            s1 = _mm512_add_pd(s1, _mm512_maskz_cvtps_pd(ALL8, _mm256_loadu_ps(a + i + 8)));
+            s2 = _mm512_add_pd(s2, _mm512_maskz_cvtps_pd(ALL8, _mm256_loadu_ps(a + i + 16)));
+            s3 = _mm512_add_pd(s3, _mm512_maskz_cvtps_pd(ALL8, _mm256_loadu_ps(a + i + 24)));
+        }
+        double s = lanes_f64(_mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3)));
+        return s + sum_generic<float, double>(a + i, n - i);
+    }
+#endif
+}
+
+// The best implementation supported by this CPU
+inline SumImpl best_sum_impl() {
+    const CpuFeatures& cpu = CpuFeatures::get();
+    if (cpu.avx512f) return SumImpl::AVX512;
+    if (cpu.avx2) return SumImpl::AVX2;
+    return SumImpl::GENERIC;
+}
+
+// All the implementations that this CPU can run (for tests and benchmarks)
+inline std::vector<SumImpl> supported_sum_impls() {
+    const CpuFeatures& cpu = CpuFeatures::get();
+    std::vector<SumImpl> impls = {SumImpl::GENERIC};
+    if (cpu.avx2) impls.push_back(SumImpl::AVX2);
+    if (cpu.avx512f) impls.push_back(SumImpl::AVX512);
+    return impls;
+}
+
+inline const char* sum_impl_name(SumImpl impl) {
+    switch (impl) {
+        case SumImpl::AVX512: return "avx512";
+        case SumImpl::AVX2: return "avx2";
+        default: return "generic";
+    }
+}
+
+inline uint64_t sum_array(const uint32_t *a, size_t n, SumImpl impl = best_sum_impl()) {
+    using namespace sum_kernels_detail;
+    switch (impl) {
+#if defined(__x86_64__)
+        case SumImpl::AVX512: return sum_u32_avx512(a, n);
+        case SumImpl::AVX2: return sum_u32_avx2(a, n);
+#endif
+        default: return sum_generic<uint32_t, uint64_t>(a, n);
+    }
+}
+
+inline uint64_t sum_array(const uint64_t *a, size_t n, SumImpl impl = best_sum_impl()) {
+    using namespace sum_kernels_detail;
+    switch (impl) {
+#if defined(__x86_64__)
+        case SumImpl::AVX512: return sum_u64_avx512(a, n);
+        case SumImpl::AVX2: return sum_u64_avx2(a, n);
+#endif
+        default: return sum_generic<uint64_t, uint64_t>(a, n);
+    }
+}
+
+inline double sum_array(const float *a, size_t n, SumImpl impl = best_sum_impl()) {
+    using namespace sum_kernels_detail;
+    switch (impl) {
+#if defined(__x86_64__)
+        case SumImpl::AVX512: return sum_f32_avx512(a, n);
+        case SumImpl::AVX2: return sum_f32_avx2(a, n);
+#endif
+        default: return sum_generic<float, double>(a, n);
+    }
+}
+
+/*
+ * Sum a[0..n) with the threads of the pool: the array is split in
+ * chunks of at least min_chunk elements and each chunk is summed by
+ * sum_array. The result has the type of sum_array's (uint64_t or
+ * double).
+ * */
+template<typename T>
+auto parallel_sum(const T *a, size_t n, ThreadPool& pool = ThreadPool::instance(),
+                  SumImpl impl = best_sum_impl(), size_t min_chunk = 1 << 16)
+        -> decltype(sum_array(a, n, impl)) {
+    typedef decltype(sum_array(a, n, impl)) Acc;
+
+    min_chunk = std::max(min_chunk, (size_t)1);
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>((size_t)pool.size() * 4, n / min_chunk));
+
+    // parallel_reduce over the chunk numbers: each "element" is a chunk
+    std::vector<size_t> ids(chunks);
+    std::iota(ids.begin(), ids.end(), 0);
+
+    return parallel_reduce(ids.begin(), ids.end(), Acc(0),
+            [a, n, chunks, impl](size_t c) {
+                const size_t lo = n * c / chunks;
+                const size_t hi = n * (c+1) / chunks;
+                return sum_array(a + lo, hi - lo, impl);
+            },
+            [](Acc x, Acc y) { return x + y; },
+            pool, 1);
+}
+
+#endif
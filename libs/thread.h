@@ -4,6 +4,11 @@
 #include <thread>
 #include <iostream>
 #include <atomic>
+#include <string>
+#include <memory>
+
+#include "thread_stats.h"
+#include "perf_counters.h"
 
 class Runnable {
     public:
@@ -24,13 +29,47 @@ class Thread : public Runnable {
         std::atomic<bool> _keep_running;
         std::atomic<bool> _is_alive;
 
+        bool _collect_stats;
+        std::string _stats_name;
+
+        bool _collect_perf;
+        std::string _perf_name;
+
     protected:
         bool should_keep_running() const {
             return _keep_running;
         }
 
     public:
-        Thread () : _keep_running(true), _is_alive(false) {}
+        Thread () : _keep_running(true), _is_alive(false),
+                    _collect_stats(false), _collect_perf(false) {}
+
+        // Collect the resources used by this thread (wall time, cpu time,
+        // context switches, times blocked) while it runs and register them
+        // in the ThreadStatsRegistry under the given name when it finishes.
+        //
+        // It must be called before Thread::start()
+        void enable_stats(const std::string& name) {
+            _collect_stats = true;
+            _stats_name = name;
+        }
+
+        // Read the hardware counters (cycles, instructions, LLC misses and
+        // branch misses) of this thread at the begin and at the end of
+        // Thread::run() and register them in the PerfRegistry.
+        //
+        // Regions of run() can be measured too with PerfRegion and the
+        // subclass can call PerfCounters::count_items() to get the cost
+        // per item processed.
+        //
+        // If the counters are not available (no PMU, no permissions),
+        // they are reported as "n/a" and the thread runs normally.
+        //
+        // It must be called before Thread::start()
+        void enable_perf_counters(const std::string& name) {
+            _collect_perf = true;
+            _perf_name = name;
+        }
 
         void start() override {
             _is_alive = true;
@@ -43,6 +82,18 @@ class Thread : public Runnable {
         }
 
         void main() {
+            ThreadStats begin;
+            if (_collect_stats) {
+                begin = ThreadStats::snapshot();
+            }
+
+            std::unique_ptr<PerfCounters> counters;
+            PerfSample perf_begin;
+            if (_collect_perf) {
+                counters.reset(new PerfCounters());
+                perf_begin = counters->read();
+            }
+
             try {
                 this->run();
             } catch(const std::exception &err) {
@@ -51,6 +102,18 @@ class Thread : public Runnable {
                 std::cerr << "Unexpected exception: <unknown>\n";
             }
 
+            if (_collect_stats) {
+                ThreadStats used = ThreadStats::snapshot() - begin;
+                used.name = _stats_name;
+                ThreadStatsRegistry::instance().add(used);
+            }
+
+            if (_collect_perf) {
+                PerfRegistry::instance().add(_perf_name, "run",
+                                             counters->read() - perf_begin);
+                PerfRegion::flush(_perf_name);
+            }
+
             _is_alive = false;
         }
 
@@ -0,0 +1,221 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <thread>
+#include <climits>
+#include <algorithm>
+
+#include "thread.h"
+#include "queue.h"
+
+/*
+ * A fixed set of threads that run tasks (std::function<void()>)
+ * pushed to a shared Queue.
+ *
+ * Creating and joining a thread is expensive (hundreds of microseconds)
+ * so instead of creating a thread for each piece of work
+ * (as we did in 03_is_prime_parallel_by_inheritance.cpp) we create
+ * the threads once and we reuse them.
+ *
+ * A pool may have 0 workers: then nobody pops the tasks but a thread
+ * that waits for them (TaskGroup::wait or try_run_one), so everything
+ * runs in the caller. That is the "1 thread" baseline of the benchmarks:
+ * the parallel algorithms also work in the calling thread, so a pool of
+ * n - 1 workers uses n threads.
+ * */
+class ThreadPool {
+    private:
+        typedef std::function<void()> Task;
+
+        class Worker : public Thread {
+            private:
+                Queue<Task>& tasks;
+
+            public:
+                explicit Worker(Queue<Task>& tasks) : tasks(tasks) {}
+
+                virtual void run() override {
+                    while (true) {
+                        Task task;
+                        try {
+                            task = tasks.pop();
+                        } catch (const ClosedQueue&) {
+                            break;
+                        }
+                        task();
+                    }
+                }
+        };
+
+        Queue<Task> tasks;
+        std::vector<Thread*> workers;
+
+    public:
+        // One per core (hardware_concurrency() may return 0 if unknown)
+        static unsigned int default_size() {
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        explicit ThreadPool(unsigned int workers_cnt = default_size()) :
+            tasks(UINT_MAX-1) {
+            for (unsigned int i = 0; i < workers_cnt; ++i) {
+                Thread *t = new Worker(tasks);
+                workers.push_back(t);
+                t->start();
+            }
+        }
+
+        // The pool shared by the libs when the caller does not give one:
+        // one thread per core.
+        static ThreadPool& instance() {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        unsigned int size() const {
+            return workers.size();
+        }
+
+        // The task must not throw: nobody would catch the exception.
+        // Use TaskGroup to get the exceptions back. With 0 workers the
+        // task runs only when someone calls try_run_one.
+        void submit(const Task& task) {
+            tasks.push(task);
+        }
+
+        // Run one pending task in the calling thread, if there is any.
+        // This is how a thread that waits for its tasks can help
+        // instead of just blocking.
+        bool try_run_one() {
+            Task task;
+            if (not tasks.try_pop(task)) {
+                return false;
+            }
+            task();
+            return true;
+        }
+
+        ~ThreadPool() {
+            tasks.close();
+            for (Thread *t : workers) {
+                t->join();
+                delete t;
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+};
+
+/*
+ * A set of tasks submitted to a ThreadPool that can be waited as a whole.
+ *
+ * wait() does not just block: while there are tasks in the pool's queue
+ * the waiting thread runs them. That makes safe to use a TaskGroup from
+ * a task of the same pool (nested parallelism): the worker waiting
+ * never leaves its own tasks queued behind it.
+ *
+ * If a task throws, wait() rethrows the first exception.
+ * */
+class TaskGroup {
+    private:
+        ThreadPool& pool;
+
+        std::mutex mtx;
+        std::condition_variable all_done;
+        unsigned long pending;
+        std::exception_ptr error;
+
+        void finished(std::exception_ptr err) {
+            std::unique_lock<std::mutex> lck(mtx);
+            if (err and not error) {
+                error = err;
+            }
+
+            --pending;
+            if (pending == 0) {
+                all_done.notify_all();
+            }
+        }
+
+    public:
+        explicit TaskGroup(ThreadPool& pool = ThreadPool::instance()) :
+            pool(pool), pending(0) {}
+
+        void run(const std::function<void()>& task) {
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                ++pending;
+            }
+
+            pool.submit([this, task]() {
+                std::exception_ptr err;
+                try {
+                    task();
+                } catch (...) {
+                    err = std::current_exception();
+                }
+                this->finished(err);
+            });
+        }
+
+        void wait() {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lck(mtx);
+                    if (pending == 0) {
+                        break;
+                    }
+                }
+
+                if (not pool.try_run_one()) {
+                    // Nothing to help with: our tasks are running in
+                    // other threads, just wait for them
+                    std::unique_lock<std::mutex> lck(mtx);
+                    while (pending > 0) {
+                        all_done.wait(lck);
+                    }
+                    break;
+                }
+            }
+
+            std::unique_lock<std::mutex> lck(mtx);
+            if (error) {
+                std::exception_ptr err = error;
+                error = nullptr;
+                std::rethrow_exception(err);
+            }
+        }
+
+        ~TaskGroup() {
+            // The tasks have a pointer to us: they must finish first. If
+            // wait() was skipped (an exception), help to run them: with
+            // a pool of 0 workers nobody else would
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lck(mtx);
+                    if (pending == 0) {
+                        return;
+                    }
+                }
+                if (not pool.try_run_one()) {
+                    break;
+                }
+            }
+
+            std::unique_lock<std::mutex> lck(mtx);
+            while (pending > 0) {
+                all_done.wait(lck);
+            }
+        }
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+};
+
+#endif
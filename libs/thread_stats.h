@@ -0,0 +1,197 @@
+#ifndef THREAD_STATS_H_
+#define THREAD_STATS_H_
+
+#include <sys/resource.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <stdexcept>
+
+/*
+ * Resources consumed by a single thread.
+ *
+ * Times are in nanoseconds. The context switches come from
+ * getrusage(RUSAGE_THREAD):
+ *
+ *  - voluntary: the thread gave up the CPU (it blocked on a mutex,
+ *    a conditional variable, a sleep, a read(), ...)
+ *  - involuntary: the scheduler took the CPU away (time slice
+ *    expired or a higher priority thread showed up)
+ *
+ * blocked_cnt counts how many times the thread had to wait on a
+ * blocking operation of our libs (like Queue::pop() on an empty queue).
+ *
+ * A thread with cpu_ns close to wall_ns is CPU-bound; a thread with
+ * a lot of voluntary switches and a small cpu_ns is starved or
+ * over-contended.
+ * */
+struct ThreadStats {
+    std::string name;
+
+    unsigned long long wall_ns = 0;
+    unsigned long long cpu_ns = 0;
+    long voluntary_ctxsw = 0;
+    long involuntary_ctxsw = 0;
+    unsigned long blocked_cnt = 0;
+
+    // Read the counters of the *calling* thread. The stats of
+    // a thread can be read only from the thread itself.
+    static ThreadStats snapshot() {
+        ThreadStats s;
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        s.wall_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        s.cpu_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+        struct rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+            s.voluntary_ctxsw = usage.ru_nvcsw;
+            s.involuntary_ctxsw = usage.ru_nivcsw;
+        }
+
+        s.blocked_cnt = blocked_counter();
+        return s;
+    }
+
+    // The difference between two snapshots of the same thread.
+    ThreadStats operator-(const ThreadStats& since) const {
+        ThreadStats d;
+        d.name = name;
+        d.wall_ns = wall_ns - since.wall_ns;
+        d.cpu_ns = cpu_ns - since.cpu_ns;
+        d.voluntary_ctxsw = voluntary_ctxsw - since.voluntary_ctxsw;
+        d.involuntary_ctxsw = involuntary_ctxsw - since.involuntary_ctxsw;
+        d.blocked_cnt = blocked_cnt - since.blocked_cnt;
+        return d;
+    }
+
+    // Called by the blocking operations each time that the calling
+    // thread is about to wait. It is a thread local counter so
+    // it is cheap: no atomics, no locks.
+    static void on_blocked() {
+        ++blocked_counter();
+    }
+
+    private:
+        static unsigned long& blocked_counter() {
+            static thread_local unsigned long cnt = 0;
+            return cnt;
+        }
+};
+
+/*
+ * Registry of the stats of the finished threads.
+ *
+ * Thread::main() registers here the stats of the threads that
+ * have the stats enabled (see Thread::enable_stats()).
+ *
+ * The table can be dumped at any moment calling dump() (for example
+ * at the end of the main()) or it can be dumped when the process
+ * receives a signal (see dump_on_signal())
+ * */
+class ThreadStatsRegistry {
+    private:
+        std::mutex mtx;
+        std::vector<ThreadStats> finished;
+
+        ThreadStatsRegistry() {}
+
+    public:
+        static ThreadStatsRegistry& instance() {
+            static ThreadStatsRegistry registry;
+            return registry;
+        }
+
+        void add(const ThreadStats& stats) {
+            std::unique_lock<std::mutex> lck(mtx);
+            finished.push_back(stats);
+        }
+
+        std::vector<ThreadStats> get_all() {
+            std::unique_lock<std::mutex> lck(mtx);
+            return finished;
+        }
+
+        void clear() {
+            std::unique_lock<std::mutex> lck(mtx);
+            finished.clear();
+        }
+
+        void dump(std::ostream& out) {
+            std::unique_lock<std::mutex> lck(mtx);
+
+            out << std::left << std::setw(20) << "thread"
+                << std::right
+                << std::setw(12) << "wall ms"
+                << std::setw(12) << "cpu ms"
+                << std::setw(8) << "cpu %"
+                << std::setw(10) << "vol cs"
+                << std::setw(10) << "invol cs"
+                << std::setw(10) << "blocked" << "\n";
+
+            for (const auto& s : finished) {
+                double cpu_pct = s.wall_ns ? (100.0 * s.cpu_ns) / s.wall_ns : 0;
+                out << std::left << std::setw(20) << s.name
+                    << std::right << std::fixed << std::setprecision(2)
+                    << std::setw(12) << s.wall_ns / 1e6
+                    << std::setw(12) << s.cpu_ns / 1e6
+                    << std::setprecision(1)
+                    << std::setw(8) << cpu_pct
+                    << std::setw(10) << s.voluntary_ctxsw
+                    << std::setw(10) << s.involuntary_ctxsw
+                    << std::setw(10) << s.blocked_cnt << "\n";
+            }
+        }
+
+        // Dump the table to stderr when the process exits normally
+        // (returning from main() or calling exit())
+        void dump_at_exit() {
+            std::atexit([]() { ThreadStatsRegistry::instance().dump(std::cerr); });
+        }
+
+        /*
+         * Dump the table to stderr each time that the process receives
+         * the given signal (for example SIGUSR1).
+         *
+         * Writing to a stream from a signal handler is *not* safe so
+         * instead we block the signal and we launch a thread that
+         * waits for it with sigwait(). The dump then happens in a
+         * regular thread.
+         *
+         * Note: the signal mask is inherited so this must be called
+         * *before* starting any other thread, otherwise the signal may
+         * be delivered to a thread that did not block it.
+         * */
+        void dump_on_signal(int signum) {
+            sigset_t set;
+            sigemptyset(&set);
+            sigaddset(&set, signum);
+
+            if (pthread_sigmask(SIG_BLOCK, &set, nullptr) != 0) {
+                throw std::runtime_error("pthread_sigmask failed");
+            }
+
+            std::thread([this, set]() {
+                int sig;
+                while (sigwait(&set, &sig) == 0) {
+                    this->dump(std::cerr);
+                }
+            }).detach();
+        }
+
+        ThreadStatsRegistry(const ThreadStatsRegistry&) = delete;
+        ThreadStatsRegistry& operator=(const ThreadStatsRegistry&) = delete;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "../libs/actor.h"
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+/*
+ * A small test for Actor<Msg>, ActorPool and BoundedMailbox<T>
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int ACTORS_CNT = 1000;
+    const int MSG_PER_ACTOR = 100;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+class Counter : public Actor<int> {
+    public:
+        // No locks: receive() is never called concurrently
+        long sum;
+        int last;
+        bool in_order;
+
+        explicit Counter(ActorPool& pool, size_t mailbox_size = DEFAULT_MAILBOX_SIZE) :
+            Actor<int>(pool, mailbox_size), sum(0), last(0), in_order(true) {}
+
+        virtual void receive(const int& n) override {
+            sum += n;
+            in_order = in_order and (n == last + 1);
+            last = n;
+        }
+};
+
+void test_mailbox_is_bounded_and_fifo() {
+    BoundedMailbox<int> mailbox(5);
+    int val;
+
+    // The capacity is rounded up to a power of 2
+    raise_if_false(mailbox.capacity() == 8);
+
+    for (int i = 0; i < 8; ++i) {
+        raise_if_false(mailbox.try_push(i));
+    }
+    raise_if_false(not mailbox.try_push(999));
+
+    for (int i = 0; i < 8; ++i) {
+        raise_if_false(mailbox.try_pop(val));
+        raise_if_false(val == i);
+    }
+    raise_if_false(not mailbox.try_pop(val));
+    raise_if_false(mailbox.empty());
+
+    std::cout << "[OK] test_mailbox_is_bounded_and_fifo\n";
+}
+
+void test_many_actors_few_threads() {
+    ActorPool pool(4);
+    std::vector<Counter*> actors(ACTORS_CNT);
+
+    for (int i = 0; i < ACTORS_CNT; ++i) {
+        actors[i] = new Counter(pool);
+    }
+
+    for (int m = 1; m <= MSG_PER_ACTOR; ++m) {
+        for (int i = 0; i < ACTORS_CNT; ++i) {
+            actors[i]->send(m);
+        }
+    }
+
+    pool.wait_idle();
+
+    for (int i = 0; i < ACTORS_CNT; ++i) {
+        raise_if_false(actors[i]->sum == (long)MSG_PER_ACTOR * (MSG_PER_ACTOR + 1) / 2);
+        raise_if_false(actors[i]->in_order);
+        delete actors[i];
+    }
+
+    std::cout << "[OK] test_many_actors_few_threads\n";
+}
+
+void test_backpressure_on_full_mailbox() {
+    ActorPool pool(1);
+    Counter actor(pool, 4);
+
+    // The mailbox has room for 4 messages: send() must wait for
+    // the actor to make room instead of dropping messages
+    const int cnt = 100000;
+    for (int m = 1; m <= cnt; ++m) {
+        actor.send(m);
+    }
+
+    pool.wait_idle();
+    raise_if_false(actor.sum == (long)cnt * (cnt + 1) / 2);
+    raise_if_false(actor.in_order);
+
+    std::cout << "[OK] test_backpressure_on_full_mailbox\n";
+}
+
+int main() try {
+    test_mailbox_is_bounded_and_fifo();
+    test_many_actors_few_threads();
+    test_backpressure_on_full_mailbox();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
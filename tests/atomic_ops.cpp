@@ -0,0 +1,134 @@
+#include "../libs/thread.h"
+#include "../libs/atomic_ops.h"
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+
+/*
+ * A small test for fetch_update, update_if and SetOnceLatch<T>
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int THREADS_CNT = 16;
+    const int TRIES_PER_THREAD = 10000;
+    const unsigned int LIMIT = 50000;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+// Increment while the counter is below LIMIT: with a plain
+// "if (get() < LIMIT) inc()" we would overshoot the limit.
+class BoundedIncrementer : public Thread {
+    private:
+        std::atomic<unsigned int>& counter;
+
+    public:
+        explicit BoundedIncrementer(std::atomic<unsigned int>& counter) : counter(counter) {}
+
+        virtual void run() override {
+            for (int i = 0; i < TRIES_PER_THREAD; ++i) {
+                update_if(counter,
+                        [](unsigned int v) { return v < LIMIT; },
+                        [](unsigned int v) { return v + 1; });
+            }
+        }
+};
+
+class Setter : public Thread {
+    private:
+        SetOnceLatch<int>& latch;
+        std::atomic<int>& winners;
+        const int id;
+
+    public:
+        Setter(SetOnceLatch<int>& latch, std::atomic<int>& winners, int id) :
+            latch(latch), winners(winners), id(id) {}
+
+        virtual void run() override {
+            if (latch.set(id)) {
+                ++winners;
+            }
+        }
+};
+
+void test_fetch_update() {
+    std::atomic<int> a(5);
+
+    auto old = fetch_update(a, [](int v) -> std::optional<int> { return v * 2; });
+    raise_if_false(old.has_value() and *old == 5);
+    raise_if_false(a == 10);
+
+    old = fetch_update(a, [](int) -> std::optional<int> { return std::nullopt; });
+    raise_if_false(not old.has_value());
+    raise_if_false(a == 10);
+
+    std::cout << "[OK] test_fetch_update\n";
+}
+
+void test_update_if_never_overshoots() {
+    std::atomic<unsigned int> counter(0);
+
+    std::vector<Thread*> threads;
+    for (int i = 0; i < THREADS_CNT; ++i) {
+        threads.push_back(new BoundedIncrementer(counter));
+    }
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+
+    raise_if_false(counter == LIMIT);
+
+    std::cout << "[OK] test_update_if_never_overshoots\n";
+}
+
+void test_set_once_latch() {
+    SetOnceLatch<int> latch;
+    std::atomic<int> winners(0);
+    int v = -1;
+
+    raise_if_false(not latch.is_set());
+    raise_if_false(not latch.try_get(v));
+
+    std::vector<Thread*> threads;
+    for (int i = 0; i < THREADS_CNT; ++i) {
+        threads.push_back(new Setter(latch, winners, i));
+    }
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+
+    raise_if_false(winners == 1);
+    raise_if_false(latch.is_set());
+    raise_if_false(latch.try_get(v));
+    raise_if_false(0 <= v and v < THREADS_CNT);
+
+    std::cout << "[OK] test_set_once_latch\n";
+}
+
+int main() try {
+    test_fetch_update();
+    test_update_if_never_overshoots();
+    test_set_once_latch();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
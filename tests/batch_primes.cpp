@@ -0,0 +1,89 @@
+#include "../libs/batch_primes.h"
+#include "../libs/miller_rabin.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <stdexcept>
+
+/*
+ * A small test for the batched trial division
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+void check_all_impls(const std::vector<unsigned int>& nums) {
+    for (TrialDivisionImpl impl : supported_trial_division_impls()) {
+        std::vector<uint64_t> bitmap = is_prime_batch(nums.data(), nums.size(), impl);
+        raise_if_false(bitmap.size() == (nums.size() + 63) / 64);
+
+        for (size_t i = 0; i < nums.size(); ++i) {
+            bool prime = bitmap[i / 64] & (uint64_t(1) << (i % 64));
+            raise_if_false(prime == is_prime_fast(nums[i]));
+        }
+
+        // No bit beyond the last number
+        if (nums.size() % 64) {
+            raise_if_false((bitmap.back() >> (nums.size() % 64)) == 0);
+        }
+    }
+}
+
+void test_small_numbers() {
+    std::vector<unsigned int> nums;
+    for (unsigned int n = 0; n < 100000; ++n) {
+        nums.push_back(n);
+    }
+    check_all_impls(nums);
+
+    std::cout << "[OK] test_small_numbers\n";
+}
+
+void test_random_numbers() {
+    std::mt19937 gen(42);
+
+    // Odd lengths so the last batch is partial
+    for (size_t len : {1, 7, 9, 15, 17, 63, 65, 1001}) {
+        std::vector<unsigned int> nums(len);
+        for (unsigned int& n : nums) {
+            n = gen() >> (gen() % 32);
+        }
+        check_all_impls(nums);
+    }
+
+    std::cout << "[OK] test_random_numbers\n";
+}
+
+void test_hard_numbers() {
+    const std::vector<unsigned int> nums = {
+        0, 1, 2, 3, 4, 5, 9, 25, 49,
+        132130891, 132130871,
+        4294967291u,            // the largest 32 bits prime
+        4294967295u,
+        4293001441u,            // 65521^2: the largest prime square
+        4292870399u,            // 65519 * 65521
+        4294836225u,            // 65535^2
+        2147483647u             // 2^31 - 1
+    };
+    check_all_impls(nums);
+
+    std::cout << "[OK] test_hard_numbers\n";
+}
+
+int main() try {
+    test_small_numbers();
+    test_random_numbers();
+    test_hard_numbers();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
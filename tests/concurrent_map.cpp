@@ -0,0 +1,155 @@
+#include "../libs/thread.h"
+#include "../libs/concurrent_map.h"
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+
+/*
+ * A small test for ConcurrentMap<K, V>
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int THREADS_CNT = 4;
+    const int IDS_CNT = 20000;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+// Like the Student of 13_fixme.cpp but all the students mark the
+// attendance of all the ids: each id must be added once and counted
+// once per thread.
+class Student : public Thread {
+    private:
+        ConcurrentMap<int, int>& list;
+        std::atomic<int>& added;
+
+    public:
+        Student(ConcurrentMap<int, int>& list, std::atomic<int>& added) :
+            list(list), added(added) {}
+
+        virtual void run() override {
+            for (int id = 0; id < IDS_CNT; ++id) {
+                if (list.insert_if_absent(id, 0)) {
+                    ++added;
+                }
+                list.update(id, [](int& cnt) { ++cnt; });
+            }
+        }
+};
+
+void test_atomic_insert_and_update() {
+    ConcurrentMap<int, int> list;
+    std::atomic<int> added(0);
+
+    std::vector<Thread*> threads;
+    for (int i = 0; i < THREADS_CNT; ++i) {
+        threads.push_back(new Student(list, added));
+    }
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+
+    raise_if_false(added == IDS_CNT);
+    raise_if_false(list.size() == IDS_CNT);
+
+    long total = 0;
+    bool ok = true;
+    list.for_each([&](int id, int cnt) {
+        total += cnt;
+        ok = ok and cnt == THREADS_CNT and id >= 0 and id < IDS_CNT;
+    });
+    raise_if_false(ok);
+    raise_if_false(total == (long)IDS_CNT * THREADS_CNT);
+
+    std::cout << "[OK] test_atomic_insert_and_update\n";
+}
+
+void test_upsert() {
+    ConcurrentMap<int, bool> list;
+
+    list.upsert(7, false, [](bool& present) { present = true; });
+    list.upsert(8, false, [](bool&) {});
+
+    bool present = false;
+    raise_if_false(list.find(7, present) and present);
+    raise_if_false(list.find(8, present) and not present);
+    raise_if_false(not list.find(9, present));
+    raise_if_false(not list.update(9, [](bool& p) { p = true; }));
+
+    std::cout << "[OK] test_upsert\n";
+}
+
+// Compare against std::unordered_map with a random sequence of inserts
+// and erases so the tables grow and the backward shift runs a lot.
+void test_against_unordered_map() {
+    ConcurrentMap<long, long> map(1);
+    std::unordered_map<long, long> expected;
+
+    srand(42);
+    for (int i = 0; i < 200000; ++i) {
+        long key = rand() % 5000;
+        if (rand() % 3 == 0) {
+            raise_if_false(map.erase(key) == (expected.erase(key) == 1));
+        } else {
+            bool inserted = expected.emplace(key, i).second;
+            raise_if_false(map.insert_if_absent(key, i) == inserted);
+        }
+    }
+
+    raise_if_false(map.size() == expected.size());
+    for (const auto& p : expected) {
+        long val = -1;
+        raise_if_false(map.find(p.first, val) and val == p.second);
+    }
+    for (long key = 0; key < 5000; ++key) {
+        raise_if_false(map.contains(key) == (expected.count(key) == 1));
+    }
+
+    std::cout << "[OK] test_against_unordered_map\n";
+}
+
+// Invalid shard bits are rejected before allocating: 40 would be 2^40
+// shards (a bad_alloc) if the check came after the allocation
+void test_invalid_shard_bits() {
+    for (unsigned int bits : {0u, 17u, 40u, 64u, 100u}) {
+        bool thrown = false;
+        try {
+            ConcurrentMap<int, int> map(bits);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        raise_if_false(thrown);
+    }
+
+    ConcurrentMap<int, int> map(16);
+    raise_if_false(map.insert_if_absent(1, 1));
+
+    std::cout << "[OK] test_invalid_shard_bits\n";
+}
+
+int main() try {
+    test_atomic_insert_and_update();
+    test_upsert();
+    test_against_unordered_map();
+    test_invalid_shard_bits();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
@@ -0,0 +1,156 @@
+#include "../libs/thread.h"
+#include "../libs/dense_registry.h"
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+
+/*
+ * A small test for DenseRegistry and the popcount kernels
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int THREADS_CNT = 4;
+    const size_t IDS_CNT = 100003; // not a multiple of 64
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+// All the kernels must agree with the generic one, for all the
+// lengths around the vector widths (the tails are the tricky part)
+void test_popcount_impls() {
+    std::vector<uint64_t> a(1000), b(1000);
+    srand(42);
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = ((uint64_t)rand() << 33) ^ ((uint64_t)rand() << 11) ^ rand();
+        b[i] = ((uint64_t)rand() << 33) ^ ((uint64_t)rand() << 11) ^ rand();
+    }
+    a[7] = ~uint64_t(0); // a word full of ones
+
+    for (PopcountImpl impl : supported_popcount_impls()) {
+        for (size_t n = 0; n <= a.size(); n += (n < 40 ? 1 : 97)) {
+            uint64_t expected = 0, expected_andnot = 0;
+            for (size_t i = 0; i < n; ++i) {
+                expected += __builtin_popcountll(a[i]);
+                expected_andnot += __builtin_popcountll(a[i] & ~b[i]);
+            }
+            raise_if_false(popcount_words(a.data(), n, impl) == expected);
+            raise_if_false(popcount_words_andnot(a.data(), b.data(), n, impl) == expected_andnot);
+        }
+        std::cout << "[OK] test_popcount_impls " << popcount_impl_name(impl) << "\n";
+    }
+}
+
+// Each student enrolls all the ids and marks the ones that belong to it
+class Student : public Thread {
+    private:
+        int n;
+        DenseRegistry& list;
+
+    public:
+        Student(int n, DenseRegistry& list) : n(n), list(list) {}
+
+        virtual void run() override {
+            for (size_t id = 0; id < IDS_CNT; ++id) {
+                list.enroll(id);
+                if (id % THREADS_CNT == (size_t)n and id % 3 != 0) {
+                    list.mark_present(id);
+                }
+            }
+        }
+};
+
+void test_concurrent_marking() {
+    DenseRegistry list(IDS_CNT);
+
+    std::vector<Thread*> threads;
+    for (int i = 0; i < THREADS_CNT; ++i) {
+        threads.push_back(new Student(i, list));
+    }
+    for (Thread *t : threads) {
+        t->start();
+    }
+
+    // The live counts can run while the threads mark
+    bool live_ok = true;
+    for (int i = 0; i < 100; ++i) {
+        live_ok = live_ok and list.live_enrolled_count() <= IDS_CNT
+                          and list.live_present_count() <= IDS_CNT;
+    }
+
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+    raise_if_false(live_ok);
+
+    size_t expected_present = IDS_CNT - (IDS_CNT + 2) / 3;
+    for (PopcountImpl impl : supported_popcount_impls()) {
+        raise_if_false(list.enrolled_count(impl) == IDS_CNT);
+        raise_if_false(list.present_count(impl) == expected_present);
+        raise_if_false(list.absent_count(impl) == IDS_CNT - expected_present);
+    }
+    raise_if_false(list.live_enrolled_count() == IDS_CNT);
+    raise_if_false(list.live_present_count() == expected_present);
+    raise_if_false(list.live_absent_count() == IDS_CNT - expected_present);
+
+    size_t visited = 0;
+    bool ok = true;
+    list.for_each_enrolled([&](size_t id, bool present) {
+        ok = ok and id == visited and present == (id % 3 != 0);
+        ++visited;
+    });
+    raise_if_false(ok and visited == IDS_CNT);
+
+    std::cout << "[OK] test_concurrent_marking\n";
+}
+
+void test_enroll_rules() {
+    DenseRegistry list(10);
+
+    raise_if_false(list.enroll(3));
+    raise_if_false(not list.enroll(3));
+    raise_if_false(list.mark_present(3));
+    raise_if_false(not list.mark_present(3));
+
+    bool thrown = false;
+    try {
+        list.mark_present(4);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    raise_if_false(thrown);
+
+    thrown = false;
+    try {
+        list.enroll(10);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    raise_if_false(thrown);
+
+    list.enroll_and_mark_present(9);
+    raise_if_false(list.is_enrolled(9) and list.is_present(9));
+    raise_if_false(not list.is_enrolled(4));
+
+    std::cout << "[OK] test_enroll_rules\n";
+}
+
+int main() try {
+    test_popcount_impls();
+    test_concurrent_marking();
+    test_enroll_rules();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
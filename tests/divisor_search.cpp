@@ -0,0 +1,115 @@
+#include "../libs/divisor_search.h"
+#include "../libs/miller_rabin.h"
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+/*
+ * A small test for DivisorSearch
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+void test_small_numbers() {
+    ThreadPool pool(3);
+    for (uint64_t n = 0; n < 20000; ++n) {
+        raise_if_false(is_prime_parallel(n, pool) == is_prime_fast(n));
+    }
+
+    // Tiny blocks so the block boundaries are hit a lot
+    for (uint64_t n = 0; n < 5000; ++n) {
+        DivisorSearch search(n, 1);
+        search.work();
+        raise_if_false(search.is_prime() == is_prime_fast(n));
+    }
+
+    std::cout << "[OK] test_small_numbers\n";
+}
+
+void test_large_numbers() {
+    ThreadPool pool(4);
+
+    const uint64_t nums[] = {
+        132130891, 132130871,
+        1099511627791ULL,                   // a prime near 2^40
+        1048573ULL * 1048571ULL,            // two primes near 2^20
+        4294967291ULL * 3                   // a small factor
+    };
+    for (uint64_t n : nums) {
+        raise_if_false(is_prime_parallel(n, pool) == is_prime_fast(n));
+    }
+
+    std::cout << "[OK] test_large_numbers\n";
+}
+
+// The nums of 03 with a few workers helping each other
+void test_workers_help_each_other() {
+    const uint64_t nums[] = { 0, 1, 2, 132130891, 132130891, 4, 13,
+                              132130891, 132130891, 132130871 };
+
+    std::vector<DivisorSearch*> searches;
+    for (uint64_t n : nums) {
+        searches.push_back(new DivisorSearch(n));
+    }
+
+    std::vector<Thread*> workers;
+    for (size_t i = 0; i < 4; ++i) {
+        workers.push_back(new PrimeSearchWorker(searches, i * 3));
+        workers.back()->start();
+    }
+    for (Thread *t : workers) {
+        t->join();
+        delete t;
+    }
+
+    for (size_t i = 0; i < searches.size(); ++i) {
+        raise_if_false(searches[i]->is_decided());
+        raise_if_false(searches[i]->is_prime() == is_prime_fast(nums[i]));
+        delete searches[i];
+    }
+
+    std::cout << "[OK] test_workers_help_each_other\n";
+}
+
+// Once a divisor is found the helpers stop: far less than all the
+// divisors up to sqrt(n) are tried
+void test_cancellation() {
+    const uint64_t n = 3ULL * 1099511627791ULL;  // sqrt(n) ~ 1.8 millions
+    DivisorSearch search(n, 1024);
+
+    std::vector<Thread*> helpers;
+    std::vector<DivisorSearch*> searches = { &search };
+    for (int i = 0; i < 4; ++i) {
+        helpers.push_back(new PrimeSearchWorker(searches, 0));
+        helpers.back()->start();
+    }
+    for (Thread *t : helpers) {
+        t->join();
+        delete t;
+    }
+
+    raise_if_false(not search.is_prime());
+    raise_if_false(search.divisors_tested() < 4 * 1024 + 1);
+
+    std::cout << "[OK] test_cancellation\n";
+}
+
+int main() try {
+    test_small_numbers();
+    test_large_numbers();
+    test_workers_help_each_other();
+    test_cancellation();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
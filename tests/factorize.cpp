@@ -0,0 +1,126 @@
+#include "../libs/factorize.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <stdexcept>
+
+/*
+ * A small test for the factorization
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+typedef std::vector<uint64_t> Factors;
+
+// The factors are primes, in order, and their product is n
+void check_factors(uint64_t n, const Factors& factors) {
+    uint128_t product = 1;
+    for (size_t i = 0; i < factors.size(); ++i) {
+        raise_if_false(is_prime_fast(factors[i]));
+        raise_if_false(i == 0 or factors[i-1] <= factors[i]);
+        product *= factors[i];
+    }
+    raise_if_false(product == n);
+}
+
+Factors factorize_by_trial_division(uint64_t n) {
+    Factors factors;
+    for (uint64_t d = 2; d * d <= n; ++d) {
+        while (n % d == 0) {
+            factors.push_back(d);
+            n /= d;
+        }
+    }
+    if (n > 1) {
+        factors.push_back(n);
+    }
+    return factors;
+}
+
+void test_small_numbers() {
+    raise_if_false(factorize(0).empty());
+    raise_if_false(factorize(1).empty());
+    raise_if_false(factorize(2) == Factors({2}));
+    raise_if_false(factorize(132130890) == Factors({2, 3, 3, 5, 109, 13469}));
+    raise_if_false(factorize(132130891) == Factors({132130891}));
+
+    for (uint64_t n = 2; n < 300000; ++n) {
+        raise_if_false(factorize(n) == factorize_by_trial_division(n));
+    }
+
+    std::cout << "[OK] test_small_numbers\n";
+}
+
+void test_hard_numbers() {
+    // 2^64 - 1
+    raise_if_false(factorize(18446744073709551615ULL) == Factors({3, 5, 17, 257, 641, 65537, 6700417}));
+    // Two ~32 bits primes: the worst case for rho
+    raise_if_false(factorize(18446743979220271189ULL) == Factors({4294967279ULL, 4294967291ULL}));
+    raise_if_false(factorize(1000000016000000063ULL) == Factors({1000000007, 1000000009}));
+    // A square and a large prime
+    raise_if_false(factorize(18446744030759878681ULL) == Factors({4294967291ULL, 4294967291ULL}));
+    raise_if_false(factorize(18446744073709551557ULL) == Factors({18446744073709551557ULL}));
+    // A cube of a prime just above the trial division bound
+    raise_if_false(factorize(1031ULL * 1031 * 1031) == Factors({1031, 1031, 1031}));
+
+    std::cout << "[OK] test_hard_numbers\n";
+}
+
+void test_random_numbers() {
+    std::mt19937_64 gen(42);
+
+    for (int i = 0; i < 20000; ++i) {
+        const uint64_t n = gen();
+        check_factors(n, factorize(n));
+    }
+
+    // Semiprimes of two random primes of ~20..32 bits
+    for (int i = 0; i < 200; ++i) {
+        uint64_t p = (gen() >> (32 + i % 12)) | 1, q = (gen() >> 32) | 1;
+        while (not is_prime_fast(p)) p += 2;
+        while (not is_prime_fast(q)) q += 2;
+
+        Factors expected = {std::min(p, q), std::max(p, q)};
+        raise_if_false(factorize(p * q) == expected);
+    }
+
+    std::cout << "[OK] test_random_numbers\n";
+}
+
+void test_factorize_all() {
+    std::mt19937_64 gen(7);
+    std::vector<uint64_t> nums(5000);
+    for (uint64_t& n : nums) {
+        n = gen() >> (gen() % 64);
+    }
+
+    ThreadPool pool(3);
+    std::vector<Factors> all = factorize_all(nums, pool);
+
+    raise_if_false(all.size() == nums.size());
+    for (size_t i = 0; i < nums.size(); ++i) {
+        raise_if_false(all[i] == factorize(nums[i]));
+    }
+
+    std::cout << "[OK] test_factorize_all\n";
+}
+
+int main() try {
+    test_small_numbers();
+    test_hard_numbers();
+    test_random_numbers();
+    test_factorize_all();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
@@ -0,0 +1,169 @@
+#include "../libs/fiber.h"
+#include "../libs/fiber_queue.h"
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+/*
+ * A small test for Fiber, FiberScheduler and FiberQueue<T>
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int FIBERS_CNT = 20000;
+    const int MSG_CNT = 1000;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+class Sleeper : public Fiber {
+    private:
+        std::atomic<int>& done;
+
+    public:
+        Sleeper(FiberScheduler& sched, std::atomic<int>& done) :
+            Fiber(sched), done(done) {}
+
+        virtual void run() override {
+            Fiber::sleep_for(std::chrono::milliseconds(50));
+            Fiber::yield();
+            Fiber::sleep_for(std::chrono::milliseconds(10));
+            ++done;
+        }
+};
+
+class Producer : public Fiber {
+    private:
+        FiberQueue<int>& q;
+
+    public:
+        Producer(FiberScheduler& sched, FiberQueue<int>& q) :
+            Fiber(sched), q(q) {}
+
+        virtual void run() override {
+            for (int i = 1; i <= MSG_CNT; ++i) {
+                q.push(i);
+            }
+            q.close();
+        }
+};
+
+class Consumer : public Fiber {
+    private:
+        FiberQueue<int>& q;
+        long& sum;
+
+    public:
+        Consumer(FiberScheduler& sched, FiberQueue<int>& q, long& sum) :
+            Fiber(sched), q(q), sum(sum) {}
+
+        virtual void run() override {
+            try {
+                while (true) {
+                    sum += q.pop();
+                }
+            } catch (const ClosedQueue&) {
+            }
+        }
+};
+
+class Joiner : public Fiber {
+    private:
+        Fiber& other;
+        bool& other_was_alive;
+
+    public:
+        Joiner(FiberScheduler& sched, Fiber& other, bool& other_was_alive) :
+            Fiber(sched), other(other), other_was_alive(other_was_alive) {}
+
+        virtual void run() override {
+            other.join();
+            other_was_alive = other.is_alive();
+        }
+};
+
+void test_many_sleeping_fibers() {
+    FiberScheduler sched(2);
+    std::atomic<int> done(0);
+
+    std::vector<Fiber*> fibers(FIBERS_CNT);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < FIBERS_CNT; ++i) {
+        fibers[i] = new Sleeper(sched, done);
+        fibers[i]->start();
+    }
+
+    for (int i = 0; i < FIBERS_CNT; ++i) {
+        fibers[i]->join();
+        raise_if_false(not fibers[i]->is_alive());
+        delete fibers[i];
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    raise_if_false(done == FIBERS_CNT);
+
+    // All of them slept at the same time, not one after the other
+    raise_if_false(elapsed < std::chrono::seconds(10));
+
+    std::cout << "[OK] test_many_sleeping_fibers\n";
+}
+
+void test_fiber_queue_blocks_the_fiber_not_the_worker() {
+    // A single worker: if a blocking pop() blocked the kernel thread,
+    // the producer would never run and this would hang
+    FiberScheduler sched(1);
+    FiberQueue<int> q(10);
+    long sum = 0;
+
+    Consumer consumer(sched, q, sum);
+    Producer producer(sched, q);
+
+    consumer.start();
+    producer.start();
+
+    consumer.join();
+    producer.join();
+
+    raise_if_false(sum == (long)MSG_CNT * (MSG_CNT + 1) / 2);
+
+    std::cout << "[OK] test_fiber_queue_blocks_the_fiber_not_the_worker\n";
+}
+
+void test_join_from_a_fiber() {
+    FiberScheduler sched(1);
+    std::atomic<int> done(0);
+    bool other_was_alive = true;
+
+    Sleeper sleeper(sched, done);
+    Joiner joiner(sched, sleeper, other_was_alive);
+
+    sleeper.start();
+    joiner.start();
+
+    joiner.join();
+    raise_if_false(done == 1);
+    raise_if_false(not other_was_alive);
+
+    std::cout << "[OK] test_join_from_a_fiber\n";
+}
+
+int main() try {
+    test_many_sleeping_fibers();
+    test_fiber_queue_blocks_the_fiber_not_the_worker();
+    test_join_from_a_fiber();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
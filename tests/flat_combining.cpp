@@ -0,0 +1,105 @@
+#include "../libs/thread.h"
+#include "../libs/flat_combining.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+/*
+ * A small test for FlatCombining<T>
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    // More threads than slots so some of them will not find a free slot
+    const int THREADS_CNT = 24;
+    const int OPS_PER_THREAD = 5000;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+typedef FlatCombining<std::map<int, int>, 8> Registry;
+
+class Marker : public Thread {
+    private:
+        Registry& registry;
+        const int id;
+
+    public:
+        bool ok = true;
+
+        Marker(Registry& registry, int id) : registry(registry), id(id) {}
+
+        virtual void run() override {
+            for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                // The result of the critical section comes back
+                // to the caller even if another thread ran it
+                int cnt = registry.apply([this](std::map<int, int>& m) {
+                    return ++m[id];
+                });
+                ok = ok and (cnt == i + 1);
+
+                registry.apply([](std::map<int, int>& m) {
+                    ++m[-1];
+                });
+            }
+        }
+};
+
+void test_flat_combining_from_many_threads() {
+    Registry registry;
+
+    std::vector<Marker*> threads;
+    for (int i = 0; i < THREADS_CNT; ++i) {
+        threads.push_back(new Marker(registry, i));
+    }
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Marker *t : threads) {
+        t->join();
+        raise_if_false(t->ok);
+        delete t;
+    }
+
+    registry.apply([](std::map<int, int>& m) {
+        raise_if_false(m.size() == THREADS_CNT + 1);
+        raise_if_false(m[-1] == THREADS_CNT * OPS_PER_THREAD);
+        for (int i = 0; i < THREADS_CNT; ++i) {
+            raise_if_false(m[i] == OPS_PER_THREAD);
+        }
+    });
+
+    std::cout << "[OK] test_flat_combining_from_many_threads\n";
+}
+
+void test_exceptions_go_back_to_the_caller() {
+    FlatCombining<int> counter(0);
+
+    try {
+        counter.apply([](int&) -> int { throw std::runtime_error("boom"); });
+        raise_if_false(false);
+    } catch (const std::runtime_error&) {
+    }
+
+    raise_if_false(counter.apply([](int& c) { return ++c; }) == 1);
+
+    std::cout << "[OK] test_exceptions_go_back_to_the_caller\n";
+}
+
+int main() try {
+    test_flat_combining_from_many_threads();
+    test_exceptions_go_back_to_the_caller();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
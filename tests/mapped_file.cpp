@@ -0,0 +1,124 @@
+#include "../libs/mapped_file.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+/*
+ * A small test for MappedFile
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+// A temporary file with the given contents
+std::string write_temp_file(const std::vector<uint32_t>& contents) {
+    char path[] = "/tmp/test_mapped_file_XXXXXX";
+    const int fd = mkstemp(path);
+    raise_if_false(fd != -1);
+
+    const size_t bytes = contents.size() * sizeof(uint32_t);
+    raise_if_false(write(fd, contents.data(), bytes) == (ssize_t)bytes);
+    close(fd);
+    return path;
+}
+
+void test_contents() {
+    std::vector<uint32_t> nums(100003);
+    for (size_t i = 0; i < nums.size(); ++i) {
+        nums[i] = i * 2654435761u;
+    }
+    const std::string path = write_temp_file(nums);
+
+    MappedFile::Options populated;
+    populated.populate = true;
+    populated.hugepages = true;
+
+    for (const MappedFile::Options& options : {MappedFile::Options(), populated}) {
+        MappedFile file(path, options);
+        raise_if_false(file.size() == nums.size() * sizeof(uint32_t));
+        raise_if_false(file.count<uint32_t>() == nums.size());
+        raise_if_false(file.count<uint64_t>() == nums.size() / 2);
+
+        for (size_t i = 0; i < nums.size(); ++i) {
+            raise_if_false(file.as<uint32_t>()[i] == nums[i]);
+        }
+    }
+
+    unlink(path.c_str());
+    std::cout << "[OK] test_contents\n";
+}
+
+void test_page_aligned_chunks() {
+    std::vector<uint32_t> nums(100003);
+    const std::string path = write_temp_file(nums);
+    MappedFile file(path);
+
+    const size_t per_page = MappedFile::page_size() / sizeof(uint32_t);
+    for (size_t chunks : {1, 3, 7, 16, 1000}) {
+        auto ranges = file.page_aligned_chunks(chunks, sizeof(uint32_t));
+        raise_if_false(ranges.size() >= 1 and ranges.size() <= chunks);
+
+        // Contiguous, page aligned and covering all the elements
+        raise_if_false(ranges.front().first == 0);
+        raise_if_false(ranges.back().second == nums.size());
+        for (size_t c = 0; c < ranges.size(); ++c) {
+            raise_if_false(ranges[c].first % per_page == 0);
+            raise_if_false(c == 0 or ranges[c].first == ranges[c-1].second);
+        }
+    }
+
+    bool thrown = false;
+    try {
+        file.page_aligned_chunks(4, 3);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    raise_if_false(thrown);
+
+    unlink(path.c_str());
+    std::cout << "[OK] test_page_aligned_chunks\n";
+}
+
+void test_empty_and_missing_files() {
+    const std::string path = write_temp_file({});
+    {
+        MappedFile file(path);
+        raise_if_false(file.size() == 0);
+        raise_if_false(file.count<uint32_t>() == 0);
+
+        auto ranges = file.page_aligned_chunks(4, sizeof(uint32_t));
+        raise_if_false(ranges.size() == 1 and ranges[0].first == 0 and ranges[0].second == 0);
+    }
+    unlink(path.c_str());
+
+    bool thrown = false;
+    try {
+        MappedFile file(path);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    raise_if_false(thrown);
+
+    std::cout << "[OK] test_empty_and_missing_files\n";
+}
+
+int main() try {
+    test_contents();
+    test_page_aligned_chunks();
+    test_empty_and_missing_files();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
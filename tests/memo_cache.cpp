@@ -0,0 +1,148 @@
+#include "../libs/thread.h"
+#include "../libs/memo_cache.h"
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+
+/*
+ * A small test for MemoCache
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int THREADS_CNT = 8;
+    const int KEYS_CNT = 50;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+std::atomic<int> computations[KEYS_CNT];
+
+// A slow pure function: the threads will ask for the same key while
+// it is being computed
+int slow_square(const int& k) {
+    ++computations[k];
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    return k * k;
+}
+
+class Asker : public Thread {
+    private:
+        MemoCache<int, int>& cache;
+        std::atomic<bool>& wrong;
+
+    public:
+        Asker(MemoCache<int, int>& cache, std::atomic<bool>& wrong) :
+            cache(cache), wrong(wrong) {}
+
+        virtual void run() override {
+            for (int k = 0; k < KEYS_CNT; ++k) {
+                if (cache.get_or_compute(k, slow_square) != k * k) {
+                    wrong = true;
+                }
+            }
+        }
+};
+
+void test_single_flight() {
+    MemoCache<int, int> cache(1000);
+    std::atomic<bool> wrong(false);
+
+    std::vector<Thread*> threads;
+    for (int i = 0; i < THREADS_CNT; ++i) {
+        threads.push_back(new Asker(cache, wrong));
+    }
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+
+    raise_if_false(not wrong);
+    for (int k = 0; k < KEYS_CNT; ++k) {
+        raise_if_false(computations[k] == 1);
+    }
+
+    MemoCache<int, int>::Stats stats = cache.stats();
+    raise_if_false(stats.misses == KEYS_CNT);
+    raise_if_false(stats.hits == (THREADS_CNT - 1) * KEYS_CNT);
+    raise_if_false(stats.size == KEYS_CNT);
+    raise_if_false(stats.evictions == 0);
+
+    std::cout << "[OK] test_single_flight\n";
+}
+
+void test_lru_eviction() {
+    // A single shard so the LRU order is global
+    MemoCache<int, int> cache(3, 1);
+    int calls = 0;
+    auto f = [&calls](const int& k) { ++calls; return k + 1; };
+
+    cache.get_or_compute(1, f);
+    cache.get_or_compute(2, f);
+    cache.get_or_compute(3, f);
+    cache.get_or_compute(1, f);     // 1 is now the most recent
+    cache.get_or_compute(4, f);     // evicts 2
+    raise_if_false(calls == 4);
+
+    cache.get_or_compute(1, f);
+    cache.get_or_compute(3, f);
+    raise_if_false(calls == 4);
+    cache.get_or_compute(2, f);     // computed again
+    raise_if_false(calls == 5);
+
+    MemoCache<int, int>::Stats stats = cache.stats();
+    raise_if_false(stats.size == 3);
+    raise_if_false(stats.evictions == 2);
+
+    std::cout << "[OK] test_lru_eviction\n";
+}
+
+void test_failures_are_not_cached() {
+    MemoCache<int, int> cache(10);
+    int calls = 0;
+
+    for (int i = 0; i < 2; ++i) {
+        bool thrown = false;
+        try {
+            cache.get_or_compute(7, [&calls](const int&) -> int {
+                ++calls;
+                throw std::runtime_error("oops");
+            });
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        raise_if_false(thrown);
+    }
+    raise_if_false(calls == 2);
+    raise_if_false(cache.stats().size == 0);
+
+    Memoized<int, int> square([](const int& k) { return k * k; }, 10);
+    raise_if_false(square(9) == 81 and square(9) == 81);
+    raise_if_false(square.stats().hits == 1 and square.stats().misses == 1);
+
+    std::cout << "[OK] test_failures_are_not_cached\n";
+}
+
+int main() try {
+    test_single_flight();
+    test_lru_eviction();
+    test_failures_are_not_cached();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
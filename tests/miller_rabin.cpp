@@ -0,0 +1,116 @@
+#include "../libs/miller_rabin.h"
+#include "../libs/sieve.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <stdexcept>
+
+/*
+ * A small test for Miller-Rabin and the Montgomery arithmetic
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+void test_montgomery_mul() {
+    std::mt19937_64 gen(42);
+
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t n = gen() | 1;
+        uint64_t a = gen() % n, b = gen() % n;
+        Montgomery64 m(n);
+        raise_if_false(m.from(m.mul(m.to(a), m.to(b))) == (uint128_t)a * b % n);
+
+        uint32_t n32 = (uint32_t)gen() | 1;
+        uint32_t a32 = (uint32_t)gen() % n32, b32 = (uint32_t)gen() % n32;
+        Montgomery32 m32(n32);
+        raise_if_false(m32.from(m32.mul(m32.to(a32), m32.to(b32))) == (uint64_t)a32 * b32 % n32);
+    }
+
+    std::cout << "[OK] test_montgomery_mul\n";
+}
+
+void test_against_the_sieve() {
+    ThreadPool pool(2);
+    PrimeSieve sieve(3000000, pool);
+
+    for (uint64_t n = 0; n <= 3000000; ++n) {
+        raise_if_false(is_prime_fast(n) == sieve.is_prime(n));
+    }
+
+    // Near 2^32, where the 32 bits path ends
+    const uint64_t lo = ((uint64_t)1 << 32) - 100000;
+    raise_if_false(count_primes(lo, lo + 200000, pool) == [lo]() {
+        uint64_t cnt = 0;
+        for (uint64_t n = lo; n < lo + 200000; ++n) cnt += is_prime_fast(n);
+        return cnt;
+    }());
+
+    std::cout << "[OK] test_against_the_sieve\n";
+}
+
+void test_hard_numbers() {
+    // Primes
+    raise_if_false(is_prime_fast(132130891));               // 01..03's input
+    raise_if_false(is_prime_fast(132130871));
+    raise_if_false(is_prime_fast(4294967291ULL));           // 2^32 - 5
+    raise_if_false(is_prime_fast(4294967311ULL));           // 2^32 + 15
+    raise_if_false(is_prime_fast(2305843009213693951ULL));  // 2^61 - 1
+    raise_if_false(is_prime_fast(18446744073709551557ULL)); // 2^64 - 59
+
+    // Composites that fool the naive tests
+    raise_if_false(not is_prime_fast(561));                  // Carmichael
+    raise_if_false(not is_prime_fast(2047));                 // spsp(2)
+    raise_if_false(not is_prime_fast(3215031751ULL));        // spsp(2, 3, 5, 7)
+    raise_if_false(not is_prime_fast(3825123056546413051ULL)); // spsp(2..23)
+    raise_if_false(not is_prime_fast(18446743979220271189ULL)); // (2^32-5)(2^32-17)
+    raise_if_false(not is_prime_fast(18446744073709551615ULL));
+
+    std::cout << "[OK] test_hard_numbers\n";
+}
+
+void test_functor_and_thread() {
+    const unsigned int nums[] = { 0, 1, 2, 132130891, 4, 13, 132130871 };
+    const bool expected[] = { false, false, true, true, false, true, true };
+    const size_t N = sizeof(nums) / sizeof(nums[0]);
+
+    bool results[N];
+    for (size_t i = 0; i < N; ++i) {
+        IsPrimeFast f(nums[i], results[i]);
+        f();
+        raise_if_false(results[i] == expected[i]);
+    }
+
+    bool thread_results[N];
+    std::vector<Thread*> threads;
+    for (size_t i = 0; i < N; ++i) {
+        threads.push_back(new IsPrimeFastThread(nums[i], thread_results[i]));
+        threads.back()->start();
+    }
+    for (size_t i = 0; i < N; ++i) {
+        threads[i]->join();
+        delete threads[i];
+        raise_if_false(thread_results[i] == expected[i]);
+    }
+
+    std::cout << "[OK] test_functor_and_thread\n";
+}
+
+int main() try {
+    test_montgomery_mul();
+    test_against_the_sieve();
+    test_hard_numbers();
+    test_functor_and_thread();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
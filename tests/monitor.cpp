@@ -0,0 +1,156 @@
+#include "../libs/thread.h"
+#include "../libs/monitor.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <stdexcept>
+
+/*
+ * A small test for Monitor<T, Policy>
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int WRITERS_CNT = 4;
+    const int READERS_CNT = 4;
+    const int OPS_PER_THREAD = 20000;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+// An invariant that a torn read would break: a + b == 0
+struct Pair {
+    long a;
+    long b;
+};
+
+template<class M>
+class Writer : public Thread {
+    private:
+        M& m;
+
+    public:
+        explicit Writer(M& m) : m(m) {}
+
+        virtual void run() override {
+            for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                m.with([](Pair& p) {
+                    ++p.a;
+                    --p.b;
+                });
+            }
+        }
+};
+
+template<class M>
+class Reader : public Thread {
+    private:
+        M& m;
+        std::atomic<bool>& broken;
+
+    public:
+        Reader(M& m, std::atomic<bool>& broken) : m(m), broken(broken) {}
+
+        virtual void run() override {
+            for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                bool ok = m.read([](const Pair& p) { return p.a + p.b == 0; });
+                if (not ok) {
+                    broken = true;
+                }
+            }
+        }
+};
+
+template<class Policy>
+void test_monitor_policy(const char *name) {
+    Monitor<Pair, Policy> m(Pair{0, 0});
+    std::atomic<bool> broken(false);
+
+    std::vector<Thread*> threads;
+    for (int i = 0; i < WRITERS_CNT; ++i) {
+        threads.push_back(new Writer<Monitor<Pair, Policy> >(m));
+    }
+    for (int i = 0; i < READERS_CNT; ++i) {
+        threads.push_back(new Reader<Monitor<Pair, Policy> >(m, broken));
+    }
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+
+    raise_if_false(not broken);
+    long a = m.read([](const Pair& p) { return p.a; });
+    raise_if_false(a == WRITERS_CNT * OPS_PER_THREAD);
+
+    std::cout << "[OK] test_monitor_policy " << name << "\n";
+}
+
+void test_monitor_of_a_map() {
+    Monitor<std::map<int, bool>, SharedLock> list;
+
+    for (int id = 0; id < 10; ++id) {
+        bool added = list.with([id](std::map<int, bool>& l) {
+            return l.emplace(id, id % 2 == 0).second;
+        });
+        raise_if_false(added);
+    }
+
+    size_t present = list.read([](const std::map<int, bool>& l) {
+        size_t cnt = 0;
+        for (const auto& p : l) {
+            cnt += p.second;
+        }
+        return cnt;
+    });
+    raise_if_false(present == 5);
+
+    std::cout << "[OK] test_monitor_of_a_map\n";
+}
+
+// SeqLock publishes the modified copy only if the callable returns: a
+// half-applied update is never visible
+void test_seqlock_failed_update_is_not_published() {
+    Monitor<Pair, SeqLock> m(Pair{0, 0});
+
+    bool thrown = false;
+    try {
+        m.with([](Pair& p) {
+            ++p.a;
+            throw std::runtime_error("oops");
+        });
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    raise_if_false(thrown);
+    raise_if_false(m.read([](const Pair& p) { return p.a == 0 and p.b == 0; }));
+
+    long a = m.with([](Pair& p) { ++p.a; --p.b; return p.a; });
+    raise_if_false(a == 1);
+    raise_if_false(m.read([](const Pair& p) { return p.a + p.b == 0; }));
+
+    std::cout << "[OK] test_seqlock_failed_update_is_not_published\n";
+}
+
+int main() try {
+    test_monitor_policy<ExclusiveLock>("ExclusiveLock");
+    test_monitor_policy<SharedLock>("SharedLock");
+    test_monitor_policy<SeqLock>("SeqLock");
+    test_monitor_of_a_map();
+    test_seqlock_failed_update_is_not_published();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
@@ -0,0 +1,222 @@
+#include "../libs/parallel.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <numeric>
+#include <atomic>
+#include <stdexcept>
+
+/*
+ * A small test for the parallel algorithms and the ThreadPool
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+void test_parallel_reduce_sum() {
+    ThreadPool pool(4);
+    std::vector<unsigned int> nums(1000003);
+    std::iota(nums.begin(), nums.end(), 0);
+
+    unsigned long long sum = parallel_reduce(nums.begin(), nums.end(), 0ULL,
+            [](unsigned int x) { return (unsigned long long)x; },
+            [](unsigned long long a, unsigned long long b) { return a + b; },
+            pool, 1000);
+
+    raise_if_false(sum == 1000002ULL * 1000003ULL / 2);
+
+    // Empty and small ranges run in the caller
+    sum = parallel_reduce(nums.begin(), nums.begin(), 42ULL,
+            [](unsigned int x) { return (unsigned long long)x; },
+            [](unsigned long long a, unsigned long long b) { return a + b; },
+            pool);
+    raise_if_false(sum == 42);
+
+    std::cout << "[OK] test_parallel_reduce_sum\n";
+}
+
+void test_parallel_reduce_keeps_the_order() {
+    ThreadPool pool(4);
+    std::string letters;
+    for (int i = 0; i < 10000; ++i) {
+        letters += (char)('a' + i % 26);
+    }
+
+    // String concatenation is associative but not commutative
+    std::string copy = parallel_reduce(letters.begin(), letters.end(), std::string(),
+            [](char c) { return std::string(1, c); },
+            [](const std::string& a, const std::string& b) { return a + b; },
+            pool, 100);
+
+    raise_if_false(copy == letters);
+
+    std::cout << "[OK] test_parallel_reduce_keeps_the_order\n";
+}
+
+void test_task_group_nested_and_exceptions() {
+    ThreadPool pool(2);
+    std::vector<CacheAligned<int> > out(8);
+
+    // Each task waits for its own subtasks: with only 2 workers this
+    // would deadlock if wait() just blocked
+    TaskGroup outer(pool);
+    for (int i = 0; i < 8; ++i) {
+        outer.run([&pool, &out, i]() {
+            TaskGroup inner(pool);
+            for (int j = 0; j < 4; ++j) {
+                inner.run([]() {});
+            }
+            inner.wait();
+            out[i].value = i;
+        });
+    }
+    outer.wait();
+
+    for (int i = 0; i < 8; ++i) {
+        raise_if_false(out[i].value == i);
+    }
+
+    TaskGroup failing(pool);
+    failing.run([]() { throw std::runtime_error("boom"); });
+    try {
+        failing.wait();
+        raise_if_false(false);
+    } catch (const std::runtime_error& err) {
+        raise_if_false(std::string(err.what()) == "boom");
+    }
+
+    std::cout << "[OK] test_task_group_nested_and_exceptions\n";
+}
+
+void test_parallel_find() {
+    ThreadPool pool(4);
+    std::vector<unsigned int> nums(100000);
+    std::iota(nums.begin(), nums.end(), 0);
+
+    // Many matches: find_first must return the lowest one
+    auto multiple_of_977 = [](unsigned int x) { return x > 0 and x % 977 == 0; };
+    auto first = parallel_find_first(nums.begin(), nums.end(), multiple_of_977, pool, 100);
+    raise_if_false(first != nums.end() and *first == 977);
+
+    auto any = parallel_find_any(nums.begin(), nums.end(), multiple_of_977, pool, 100);
+    raise_if_false(any != nums.end() and multiple_of_977(*any));
+
+    // No match
+    auto none = [](unsigned int x) { return x > 100000; };
+    raise_if_false(parallel_find_first(nums.begin(), nums.end(), none, pool, 100) == nums.end());
+    raise_if_false(not parallel_any_of(nums.begin(), nums.end(), none, pool, 100));
+
+    // A single match at the end, and an empty range
+    auto last = parallel_find_first(nums.begin(), nums.end(),
+            [](unsigned int x) { return x == 99999; }, pool, 7);
+    raise_if_false(last == nums.end() - 1);
+    raise_if_false(parallel_find_any(nums.begin(), nums.begin(), multiple_of_977, pool) == nums.begin());
+
+    std::cout << "[OK] test_parallel_find\n";
+}
+
+// After a match the threads stop at the next chunk boundary:
+// far less than the whole range is checked
+void test_parallel_find_stops_early() {
+    ThreadPool pool(4);
+    std::vector<unsigned int> nums(1000000, 0);
+    nums[10] = 1;
+
+    std::atomic<size_t> checked(0);
+    auto it = parallel_find_any(nums.begin(), nums.end(), [&checked](unsigned int x) {
+        ++checked;
+        return x == 1;
+    }, pool, 1000);
+
+    raise_if_false(it == nums.begin() + 10);
+    raise_if_false(checked < 100000);
+
+    std::cout << "[OK] test_parallel_find_stops_early\n";
+}
+
+void test_parallel_for_schedules() {
+    ThreadPool pool(3);
+    const Schedule schedules[] = {Schedule::STATIC, Schedule::DYNAMIC, Schedule::GUIDED};
+
+    for (Schedule schedule : schedules) {
+        for (size_t grain : {1, 7, 64, 1000000}) {
+            const size_t N = 10007;
+            CacheAlignedVector<unsigned char> visits(N, 0);
+            raise_if_false((uintptr_t)visits.data() % CACHE_LINE_SIZE == 0);
+
+            // Skewed costs: a few expensive indexes
+            std::atomic<unsigned long> sink(0);
+            parallel_for(5, N, [&](size_t i) {
+                ++visits[i];
+                if (i % 1000 == 0) {
+                    unsigned long acc = 0;
+                    for (unsigned long k = 0; k < 100000; ++k) acc += k ^ i;
+                    sink += acc;
+                }
+            }, schedule, grain, pool);
+
+            for (size_t i = 0; i < N; ++i) {
+                raise_if_false(visits[i] == (i >= 5 ? 1 : 0));
+            }
+        }
+    }
+
+    // Empty range
+    parallel_for(10, 10, [](size_t) { throw std::runtime_error("called"); });
+
+    std::cout << "[OK] test_parallel_for_schedules\n";
+}
+
+// A pool of 0 workers: everything runs in the calling thread
+void test_pool_without_workers() {
+    ThreadPool pool(0);
+    raise_if_false(pool.size() == 0);
+
+    std::vector<unsigned int> nums(100000);
+    std::iota(nums.begin(), nums.end(), 0);
+    unsigned long long sum = parallel_reduce(nums.begin(), nums.end(), 0ULL,
+            [](unsigned int x) { return (unsigned long long)x; },
+            [](unsigned long long a, unsigned long long b) { return a + b; },
+            pool, 10);
+    raise_if_false(sum == 99999ULL * 100000ULL / 2);
+
+    const std::thread::id caller = std::this_thread::get_id();
+    std::atomic<int> elsewhere(0);
+    TaskGroup group(pool);
+    for (int i = 0; i < 10; ++i) {
+        group.run([&]() { elsewhere += std::this_thread::get_id() != caller; });
+    }
+    group.wait();
+    raise_if_false(elsewhere == 0);
+
+    // Without wait() (an exception) the destructor runs them
+    {
+        TaskGroup skipped(pool);
+        skipped.run([&]() { ++elsewhere; });
+    }
+    raise_if_false(elsewhere == 1);
+
+    std::cout << "[OK] test_pool_without_workers\n";
+}
+
+int main() try {
+    test_parallel_reduce_sum();
+    test_parallel_reduce_keeps_the_order();
+    test_task_group_nested_and_exceptions();
+    test_parallel_find();
+    test_parallel_find_stops_early();
+    test_parallel_for_schedules();
+    test_pool_without_workers();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
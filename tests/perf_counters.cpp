@@ -0,0 +1,94 @@
+#include "../libs/thread.h"
+
+#include <iostream>
+#include <stdexcept>
+
+/*
+ * A small test for the per-thread hardware counters.
+ *
+ * The counters may not be available (containers, VMs) so we
+ * check that the threads run and report anyway.
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+class Worker : public Thread {
+    public:
+        volatile unsigned long sink = 0;
+
+        virtual void run() override {
+            {
+                PerfRegion region("warmup");
+                for (unsigned long i = 0; i < 100000; ++i) {
+                    sink += i;
+                }
+            }
+
+            for (int item = 0; item < 10; ++item) {
+                PerfRegion region("item");
+                for (unsigned long i = 0; i < 100000; ++i) {
+                    sink += i;
+                }
+                PerfCounters::count_items();
+            }
+        }
+};
+
+void test_perf_counters_are_registered() {
+    PerfRegistry::instance().clear();
+
+    Worker with_perf;
+    Worker without_perf;
+
+    with_perf.enable_perf_counters("worker");
+    with_perf.start();
+    without_perf.start();
+
+    with_perf.join();
+    without_perf.join();
+
+    // One entry for the whole run plus one per region
+    raise_if_false(PerfRegistry::instance().size() == 3);
+
+    PerfRegistry::instance().dump(std::cout);
+
+    std::cout << "[OK] test_perf_counters_are_registered\n";
+}
+
+void test_region_without_counters_is_noop() {
+    PerfRegistry::instance().clear();
+
+    // The main thread has no counters enabled
+    raise_if_false(PerfCounters::current() == nullptr);
+    {
+        PerfRegion region("noop");
+    }
+    PerfRegion::flush("main");
+
+    raise_if_false(PerfRegistry::instance().size() == 0);
+
+    std::cout << "[OK] test_region_without_counters_is_noop\n";
+}
+
+int main() try {
+    {
+        PerfCounters probe;
+        std::cout << "Perf counters are "
+                  << (probe.available() ? "available" : "*not* available") << "\n";
+    }
+
+    test_perf_counters_are_registered();
+    test_region_without_counters_is_noop();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
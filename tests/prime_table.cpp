@@ -0,0 +1,77 @@
+#include "../libs/prime_table.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+ * A small test for the compile time prime table
+ *
+ * The whole table is checked against a trial division.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+// All of this is known at compile time
+static_assert(not PrimeTable::is_prime(0), "0 is not a prime");
+static_assert(not PrimeTable::is_prime(1), "1 is not a prime");
+static_assert(PrimeTable::is_prime(2), "2 is a prime");
+static_assert(not PrimeTable::is_prime(4), "4 is not a prime");
+static_assert(PrimeTable::is_prime(13), "13 is a prime");
+static_assert(PrimeTable::prime(0) == 2 and PrimeTable::prime(1) == 3, "the first primes");
+static_assert(not PrimeTable::contains(PrimeTable::bound), "the bound is excluded");
+
+bool is_prime_by_trial_division(uint32_t n) {
+    if (n < 2) {
+        return false;
+    }
+    for (uint32_t d = 2; d * d <= n; ++d) {
+        if (n % d == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_lookup() {
+    for (uint32_t n = 0; n < PrimeTable::bound; ++n) {
+        raise_if_false(PrimeTable::is_prime(n) == is_prime_by_trial_division(n));
+    }
+
+    std::cout << "[OK] test_lookup\n";
+}
+
+void test_list() {
+    std::vector<uint32_t> expected;
+    for (uint32_t n = 0; n < PrimeTable::bound; ++n) {
+        if (is_prime_by_trial_division(n)) {
+            expected.push_back(n);
+        }
+    }
+
+    raise_if_false(PrimeTable::count() == expected.size());
+    raise_if_false(std::equal(PrimeTable::begin(), PrimeTable::end(), expected.begin(), expected.end()));
+
+    if (PrimeTable::bound == (1 << 16)) {
+        raise_if_false(PrimeTable::count() == 6542);
+        raise_if_false(PrimeTable::prime(PrimeTable::count() - 1) == 65521);
+    }
+
+    std::cout << "[OK] test_list\n";
+}
+
+int main() try {
+    test_lookup();
+    test_list();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
@@ -0,0 +1,183 @@
+#include "../libs/thread.h"
+#include "../libs/rcu.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <stdexcept>
+
+/*
+ * A small test for Rcu<T>
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int WRITERS_CNT = 2;
+    const int READERS_CNT = 4;
+    const int OPS_PER_THREAD = 5000;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+// Counts the live versions so we can check that all are deleted
+std::atomic<long> alive(0);
+
+// An invariant that a torn or half updated snapshot would break:
+// the sum of all the values is 0
+struct Ledger {
+    std::map<int, long> accounts;
+
+    Ledger() { ++alive; }
+    Ledger(const Ledger& other) : accounts(other.accounts) { ++alive; }
+    ~Ledger() { --alive; }
+
+    long sum() const {
+        long s = 0;
+        for (const auto& p : accounts) {
+            s += p.second;
+        }
+        return s;
+    }
+};
+
+class Writer : public Thread {
+    private:
+        Rcu<Ledger>& ledger;
+        int n;
+
+    public:
+        Writer(Rcu<Ledger>& ledger, int n) : ledger(ledger), n(n) {}
+
+        virtual void run() override {
+            for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                ledger.update([this, i](Ledger& l) {
+                    l.accounts[(n * 7 + i) % 50] += 1;
+                    l.accounts[(n * 13 + i) % 50 + 50] -= 1;
+                });
+            }
+        }
+};
+
+class Reader : public Thread {
+    private:
+        Rcu<Ledger>& ledger;
+        std::atomic<bool>& broken;
+
+    public:
+        Reader(Rcu<Ledger>& ledger, std::atomic<bool>& broken) :
+            ledger(ledger), broken(broken) {}
+
+        virtual void run() override {
+            for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                auto snapshot = ledger.read();
+                if (snapshot->sum() != 0) {
+                    broken = true;
+                }
+            }
+        }
+};
+
+void test_readers_see_consistent_snapshots() {
+    {
+        Rcu<Ledger> ledger;
+        std::atomic<bool> broken(false);
+
+        std::vector<Thread*> threads;
+        for (int i = 0; i < WRITERS_CNT; ++i) {
+            threads.push_back(new Writer(ledger, i));
+        }
+        for (int i = 0; i < READERS_CNT; ++i) {
+            threads.push_back(new Reader(ledger, broken));
+        }
+        for (Thread *t : threads) {
+            t->start();
+        }
+        for (Thread *t : threads) {
+            t->join();
+            delete t;
+        }
+
+        raise_if_false(not broken);
+
+        auto snapshot = ledger.read();
+        long credits = 0;
+        for (const auto& p : snapshot->accounts) {
+            if (p.second > 0) credits += p.second;
+        }
+        raise_if_false(credits == WRITERS_CNT * OPS_PER_THREAD);
+        snapshot.release();
+
+        // Nobody reads: all the old versions can go
+        raise_if_false(ledger.retired_count() == 0);
+        raise_if_false(alive == 1);
+    }
+    raise_if_false(alive == 0);
+
+    std::cout << "[OK] test_readers_see_consistent_snapshots\n";
+}
+
+// A long report holds its snapshot while the writers go on
+void test_long_reader_does_not_stall_writers() {
+    {
+        Rcu<Ledger> ledger;
+        ledger.update([](Ledger& l) { l.accounts[1] = 1; l.accounts[2] = -1; });
+
+        auto report = ledger.read();
+
+        Writer writer(ledger, 0);
+        writer.start();
+        writer.join();
+
+        // The report still sees the version that it took...
+        raise_if_false(report->accounts.size() == 2 and report->accounts.at(1) == 1);
+
+        // ...and that version (and the newer ones) are kept
+        raise_if_false(ledger.retired_count() > 0);
+
+        report.release();
+        raise_if_false(ledger.retired_count() == 0);
+        raise_if_false(alive == 1);
+    }
+    raise_if_false(alive == 0);
+
+    std::cout << "[OK] test_long_reader_does_not_stall_writers\n";
+}
+
+void test_failed_update_is_not_published() {
+    Rcu<Ledger> ledger;
+
+    bool thrown = false;
+    try {
+        ledger.update([](Ledger& l) {
+            l.accounts[1] = 10;
+            throw std::runtime_error("oops");
+        });
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    raise_if_false(thrown);
+    raise_if_false(ledger.read()->accounts.empty());
+
+    size_t cnt = ledger.update([](Ledger& l) { l.accounts[1] = 0; return l.accounts.size(); });
+    raise_if_false(cnt == 1);
+
+    std::cout << "[OK] test_failed_update_is_not_published\n";
+}
+
+int main() try {
+    test_readers_see_consistent_snapshots();
+    test_long_reader_does_not_stall_writers();
+    test_failed_update_is_not_published();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
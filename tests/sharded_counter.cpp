@@ -0,0 +1,74 @@
+#include "../libs/thread.h"
+#include "../libs/sharded_counter.h"
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+/*
+ * A small test for ShardedCounter<T>
+ *
+ * It is not an exhaustive test.
+ * */
+
+namespace {
+    const int THREADS_CNT = 32;
+    const int INCS_PER_THREAD = 10000;
+}
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+class Incrementer : public Thread {
+    private:
+        ShardedCounter<unsigned int>& counter;
+
+    public:
+        explicit Incrementer(ShardedCounter<unsigned int>& counter) : counter(counter) {}
+
+        virtual void run() override {
+            for (int i = 0; i < INCS_PER_THREAD; ++i) {
+                counter.inc(2);
+            }
+        }
+};
+
+void test_counter_with_sharding(ShardedCounter<unsigned int>::Sharding sharding) {
+    // Less slots than threads: some threads will share a slot
+    ShardedCounter<unsigned int> counter(7, sharding, 4);
+    raise_if_false(counter.get_val() == 7);
+
+    std::vector<Thread*> threads;
+    for (int i = 0; i < THREADS_CNT; ++i) {
+        threads.push_back(new Incrementer(counter));
+    }
+    for (Thread *t : threads) {
+        t->start();
+    }
+    for (Thread *t : threads) {
+        t->join();
+        delete t;
+    }
+
+    raise_if_false(counter.get_val() == 7 + 2 * THREADS_CNT * INCS_PER_THREAD);
+}
+
+void test_sharded_counter() {
+    test_counter_with_sharding(ShardedCounter<unsigned int>::BY_THREAD);
+    test_counter_with_sharding(ShardedCounter<unsigned int>::BY_CPU);
+
+    std::cout << "[OK] test_sharded_counter\n";
+}
+
+int main() try {
+    test_sharded_counter();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
@@ -0,0 +1,120 @@
+#include "../libs/sieve.h"
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+
+/*
+ * A small test for the segmented sieve
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+// Like IsPrime::run of 01_is_prime_sequential.cpp but up to sqrt(n)
+bool is_prime_by_trial_division(uint64_t n) {
+    if (n < 2) return false;
+    for (uint64_t i = 2; i * i <= n; ++i) {
+        if (n % i == 0) return false;
+    }
+    return true;
+}
+
+void test_small_numbers() {
+    ThreadPool pool(4);
+    PrimeSieve sieve(10000, pool);
+
+    for (uint64_t n = 0; n <= 10000; ++n) {
+        raise_if_false(sieve.is_prime(n) == is_prime_by_trial_division(n));
+    }
+
+    std::vector<uint64_t> primes;
+    sieve.for_each_prime(10, 40, [&](uint64_t p) { primes.push_back(p); });
+    raise_if_false(primes == std::vector<uint64_t>({11, 13, 17, 19, 23, 29, 31, 37}));
+
+    std::cout << "[OK] test_small_numbers\n";
+}
+
+void test_known_counts() {
+    ThreadPool pool(4);
+    PrimeSieve sieve(10000000, pool);
+
+    raise_if_false(sieve.count_primes(0, 10) == 4);
+    raise_if_false(sieve.count_primes(0, 1000000) == 78498);
+    raise_if_false(sieve.count_primes(0, 10000001) == 664579);
+    raise_if_false(count_primes(0, 10000001, pool) == 664579);
+
+    // The same number that 01..03 check one by one
+    raise_if_false(sieve.is_prime(1000003));
+    raise_if_false(not sieve.is_prime(9999999));
+
+    // A pool of 0 workers: all in the caller
+    ThreadPool alone(0);
+    raise_if_false(PrimeSieve(1000000, alone).count_primes(0, 1000000) == 78498);
+    raise_if_false(count_primes(0, 1000000, alone) == 78498);
+
+    std::cout << "[OK] test_known_counts\n";
+}
+
+// Random ranges, with both ends odd or even, against each other and
+// against the trial division for the small ones
+void test_ranges() {
+    ThreadPool pool(3);
+    PrimeSieve sieve(2000000, pool);
+
+    srand(42);
+    for (int i = 0; i < 300; ++i) {
+        uint64_t lo = rand() % 2000000;
+        uint64_t hi = lo + rand() % (i < 200 ? 300 : 1500000);
+        hi = std::min<uint64_t>(hi, 2000001);
+
+        uint64_t expected = 0;
+        if (hi - lo <= 300) {
+            for (uint64_t n = lo; n < hi; ++n) {
+                expected += is_prime_by_trial_division(n);
+            }
+            raise_if_false(sieve.count_primes(lo, hi) == expected);
+        } else {
+            expected = sieve.count_primes(lo, hi);
+        }
+        raise_if_false(count_primes(lo, hi, pool) == expected);
+    }
+
+    // Ranges far beyond the sieve: only the standalone count
+    raise_if_false(count_primes(1000000000, 1000001000, pool) == 49);
+
+    std::cout << "[OK] test_ranges\n";
+}
+
+// isqrt (int_math.h) is exact where the double estimate is not
+void test_isqrt() {
+    for (uint64_t r : {0ull, 1ull, 2ull, 65535ull, 65536ull, 4294967295ull}) {
+        raise_if_false(isqrt(r * r) == r);
+        if (r > 0) {
+            raise_if_false(isqrt(r * r - 1) == r - 1);
+        }
+    }
+    raise_if_false(isqrt(UINT64_MAX) == UINT32_MAX);
+    raise_if_false(isqrt(9007199254740993ull) == 94906265);
+
+    std::cout << "[OK] test_isqrt\n";
+}
+
+int main() try {
+    test_small_numbers();
+    test_known_counts();
+    test_ranges();
+    test_isqrt();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
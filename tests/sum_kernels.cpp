@@ -0,0 +1,115 @@
+#include "../libs/sum_kernels.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <stdexcept>
+
+/*
+ * A small test for the summation kernels: every implementation that the
+ * CPU supports against a plain loop
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+void test_integers() {
+    std::mt19937_64 gen(42);
+    std::vector<uint32_t> a32(5000);
+    std::vector<uint64_t> a64(5000);
+    for (size_t i = 0; i < a32.size(); ++i) {
+        a32[i] = (uint32_t)gen();
+        a64[i] = gen();
+    }
+
+    for (SumImpl impl : supported_sum_impls()) {
+        // All the sizes around the vector widths and an unaligned start
+        for (size_t offset = 0; offset < 3; ++offset) {
+            for (size_t n = 0; n < 300; ++n) {
+                uint64_t expected32 = 0, expected64 = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    expected32 += a32[offset + i];
+                    expected64 += a64[offset + i];
+                }
+                raise_if_false(sum_array(a32.data() + offset, n, impl) == expected32);
+                raise_if_false(sum_array(a64.data() + offset, n, impl) == expected64);
+            }
+        }
+    }
+
+    std::cout << "[OK] test_integers\n";
+}
+
+void test_no_overflow() {
+    // The sum of Sum::run of 04..07 would overflow right away
+    std::vector<uint32_t> a(100003, UINT32_MAX);
+    for (SumImpl impl : supported_sum_impls()) {
+        raise_if_false(sum_array(a.data(), a.size(), impl) == (uint64_t)UINT32_MAX * a.size());
+    }
+
+    std::cout << "[OK] test_no_overflow\n";
+}
+
+void test_floats() {
+    // Small integers are exact in a float and in a double
+    std::vector<float> ints(10007);
+    for (size_t i = 0; i < ints.size(); ++i) {
+        ints[i] = float(i % 100);
+    }
+
+    // A float accumulator stops growing at 2^24 when adding 1.0f; a
+    // double one does not
+    std::vector<float> ones(20000001, 1.0f);
+
+    // 0.1f is not exact: the sum in double of the float 0.1f
+    std::vector<float> tenths(1000000, 0.1f);
+    const double expected_tenths = (double)0.1f * tenths.size();
+
+    for (SumImpl impl : supported_sum_impls()) {
+        raise_if_false(sum_array(ints.data(), ints.size(), impl) == 100 * 99 / 2 * 100 + 6 * 7 / 2 * 1.0);
+        raise_if_false(sum_array(ones.data(), ones.size(), impl) == 20000001.0);
+        raise_if_false(std::fabs(sum_array(tenths.data(), tenths.size(), impl) - expected_tenths) < 1e-6);
+    }
+
+    std::cout << "[OK] test_floats\n";
+}
+
+void test_parallel_sum() {
+    std::vector<uint32_t> a(1000003);
+    std::vector<float> f(1000003);
+    uint64_t expected = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = (uint32_t)(i * 2654435761u);
+        f[i] = float(i % 1000);
+        expected += a[i];
+    }
+
+    ThreadPool pool(3);
+    for (SumImpl impl : supported_sum_impls()) {
+        raise_if_false(parallel_sum(a.data(), a.size(), pool, impl) == expected);
+        raise_if_false(parallel_sum(f.data(), f.size(), pool, impl) == sum_array(f.data(), f.size(), SumImpl::GENERIC));
+        raise_if_false(parallel_sum(a.data(), 10, pool, impl) == sum_array(a.data(), 10, SumImpl::GENERIC));
+        raise_if_false(parallel_sum(a.data(), 0, pool, impl) == 0);
+    }
+
+    std::cout << "[OK] test_parallel_sum\n";
+}
+
+int main() try {
+    test_integers();
+    test_no_overflow();
+    test_floats();
+    test_parallel_sum();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
@@ -0,0 +1,112 @@
+#include "../libs/thread.h"
+#include "../libs/queue.h"
+
+#include <iostream>
+#include <stdexcept>
+
+/*
+ * A small test for the per-thread stats collected by Thread::main()
+ * and registered in ThreadStatsRegistry.
+ *
+ * It is not an exhaustive test.
+ * */
+
+void raise_if_false(bool ok) {
+    if (!ok)
+        throw std::runtime_error("assertion failed");
+}
+
+class Spinner : public Thread {
+    public:
+        volatile unsigned long sink = 0;
+
+        virtual void run() override {
+            for (unsigned long i = 0; i < 20000000; ++i) {
+                sink += i;
+            }
+        }
+};
+
+class Consumer : public Thread {
+    private:
+        Queue<int>& q;
+
+    public:
+        explicit Consumer(Queue<int>& q) : q(q) {}
+
+        virtual void run() override {
+            try {
+                while (true) {
+                    q.pop();
+                }
+            } catch (const ClosedQueue&) {
+            }
+        }
+};
+
+void test_stats_are_registered_only_if_enabled() {
+    ThreadStatsRegistry::instance().clear();
+
+    Spinner with_stats;
+    Spinner without_stats;
+
+    with_stats.enable_stats("spinner");
+    with_stats.start();
+    without_stats.start();
+
+    with_stats.join();
+    without_stats.join();
+
+    auto all = ThreadStatsRegistry::instance().get_all();
+    raise_if_false(all.size() == 1);
+    raise_if_false(all[0].name == "spinner");
+
+    // A spinner burns CPU so its cpu time cannot be zero
+    // and it cannot be larger than its wall time
+    raise_if_false(all[0].cpu_ns > 0);
+    raise_if_false(all[0].cpu_ns <= all[0].wall_ns);
+    raise_if_false(all[0].blocked_cnt == 0);
+
+    std::cout << "[OK] test_stats_are_registered_only_if_enabled\n";
+}
+
+void test_blocked_count_on_empty_queue() {
+    ThreadStatsRegistry::instance().clear();
+
+    Queue<int> q(10);
+    Consumer consumer(q);
+
+    consumer.enable_stats("consumer");
+    consumer.start();
+
+    // The consumer will block on the empty queue at least once:
+    // it cannot finish until we close the queue
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    q.push(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    q.close();
+
+    consumer.join();
+
+    auto all = ThreadStatsRegistry::instance().get_all();
+    raise_if_false(all.size() == 1);
+    raise_if_false(all[0].name == "consumer");
+    raise_if_false(all[0].blocked_cnt >= 1);
+    raise_if_false(all[0].voluntary_ctxsw >= 1);
+
+    ThreadStatsRegistry::instance().dump(std::cout);
+
+    std::cout << "[OK] test_blocked_count_on_empty_queue\n";
+}
+
+int main() try {
+    test_stats_are_registered_only_if_enabled();
+    test_blocked_count_on_empty_queue();
+    return 0;
+} catch (const std::exception& err) {
+    std::cout << "Exception: " << err.what() << "\n";
+    return 1;
+} catch (...) {
+    std::cout << "Unknown exception\n";
+    return 2;
+}
@@ -0,0 +1,232 @@
+/*
+ * Sum of a binary array file of GBs, mapped in memory.
+ *
+ * The file is a raw array of u32, u64 or f32 (native endianness). It is
+ * mapped with MappedFile (libs/mapped_file.h), split in page aligned
+ * chunks and each chunk is summed by its own Thread with sum_array
+ * (libs/sum_kernels.h) into a local accumulator; main() adds the
+ * partial sums once all the threads finished.
+ *
+ * To know if the sum is limited by the I/O (the disk, the page faults)
+ * or by the memory, the same threads then sum an array of the same
+ * size (up to 1 GB) already in RAM. We report for both:
+ *
+ *  - map:   the time to map the file (with --populate, the time to read
+ *           it all)
+ *  - file:  the sum over the mapped file, with its page faults (major
+ *           ones need the disk, minor ones only the page cache)
+ *  - ram:   the sum over memory: the best the file row can get
+ *
+ * If file is much slower than ram, it is I/O bound: run it twice (the
+ * second time the file is in the page cache) or try --populate.
+ *
+ * Usage:
+ *   ./tools/mmap_sum.exe <file> [u32|u64|f32] [threads] [--populate] [--hugepages] [--random]
+ *   ./tools/mmap_sum.exe --generate <file> <MB>
+ *
+ * --random disables MADV_SEQUENTIAL; --generate writes a file of u32.
+ * */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#include <sys/resource.h>
+
+#include "../libs/thread.h"
+#include "../libs/mapped_file.h"
+#include "../libs/sum_kernels.h"
+
+namespace {
+    const size_t MAX_RAM_BYTES = (size_t)1 << 30;
+}
+
+template<typename T>
+class ChunkSum : public Thread {
+    private:
+        const T *a;
+        const size_t first;
+        const size_t last;
+
+    public:
+        // Written once, when the thread finishes
+        decltype(sum_array((const T*)nullptr, 0)) result;
+
+        ChunkSum(const T *a, size_t first, size_t last) :
+            a(a), first(first), last(last), result(0) {}
+
+        virtual void run() override {
+            result = sum_array(a + first, last - first);
+        }
+};
+
+struct Faults {
+    long major;
+    long minor;
+
+    static Faults now() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return Faults{usage.ru_majflt, usage.ru_minflt};
+    }
+};
+
+// Sum a[first, last) of each range with its own thread
+template<typename T>
+auto sum_in_threads(const T *a, const std::vector<std::pair<size_t, size_t> >& ranges)
+        -> decltype(sum_array(a, 0)) {
+    std::vector<ChunkSum<T>*> threads;
+    for (const auto& range : ranges) {
+        threads.push_back(new ChunkSum<T>(a, range.first, range.second));
+        threads.back()->start();
+    }
+
+    decltype(sum_array(a, 0)) total = 0;
+    for (ChunkSum<T> *thread : threads) {
+        thread->join();
+        total += thread->result;
+        delete thread;
+    }
+    return total;
+}
+
+void report(const char *what, const char *type, size_t threads, size_t bytes, double secs,
+            const Faults& faults) {
+    std::cout << what << "," << type << "," << threads << "," << bytes << "," << secs << ","
+              << bytes / secs / 1e9 << "," << faults.major << "," << faults.minor << "\n";
+}
+
+template<typename T>
+int run(const std::string& path, const char *type, unsigned int threads_cnt, const MappedFile::Options& options) {
+    std::cout << "what,type,threads,bytes,seconds,GB_per_s,major_faults,minor_faults\n";
+
+    Faults before = Faults::now();
+    auto begin = std::chrono::steady_clock::now();
+    MappedFile file(path, options);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    Faults after = Faults::now();
+    report("map", type, 1, file.size(), elapsed.count(), Faults{after.major - before.major, after.minor - before.minor});
+
+    const size_t cnt = file.count<T>();
+    const size_t bytes = cnt * sizeof(T);
+    const std::vector<std::pair<size_t, size_t> > ranges = file.page_aligned_chunks(threads_cnt, sizeof(T));
+
+    before = Faults::now();
+    begin = std::chrono::steady_clock::now();
+    const auto file_sum = sum_in_threads(file.as<T>(), ranges);
+    elapsed = std::chrono::steady_clock::now() - begin;
+    after = Faults::now();
+    const double file_secs = elapsed.count();
+    report("file", type, ranges.size(), bytes, file_secs, Faults{after.major - before.major, after.minor - before.minor});
+
+    // The same threads over an array already in memory (touched by the
+    // memset so there are no page faults while summing)
+    const size_t ram_cnt = std::min(cnt, MAX_RAM_BYTES / sizeof(T));
+    std::vector<T> ram(ram_cnt);
+    memset(ram.data(), 1, ram_cnt * sizeof(T));
+
+    std::vector<std::pair<size_t, size_t> > ram_ranges;
+    for (size_t c = 0; c < ranges.size(); ++c) {
+        ram_ranges.push_back(std::make_pair(ram_cnt * c / ranges.size(), ram_cnt * (c+1) / ranges.size()));
+    }
+
+    before = Faults::now();
+    begin = std::chrono::steady_clock::now();
+    // The sum type of T (an integer for u32 and u64): no conversion
+    volatile decltype(file_sum) sink = sum_in_threads(ram.data(), ram_ranges);
+    (void)sink;
+    elapsed = std::chrono::steady_clock::now() - begin;
+    after = Faults::now();
+    const double ram_secs = elapsed.count();
+    report("ram", type, ram_ranges.size(), ram_cnt * sizeof(T), ram_secs, Faults{after.major - before.major, after.minor - before.minor});
+
+    std::cerr << "sum: " << file_sum << "\n";
+    if (cnt == 0) {
+        // Nothing was read: there is no throughput to compare
+        std::cerr << "file / ram throughput: no elements to sum\n";
+    } else {
+        const double ratio = (bytes / file_secs) / (ram_cnt * sizeof(T) / ram_secs);
+        std::cerr << "file / ram throughput: " << ratio * 100 << "% ("
+                  << (ratio < 0.5 ? "I/O bound" : "memory or compute bound") << ")\n";
+    }
+    if (file.size() % sizeof(T)) {
+        std::cerr << "warning: the last " << file.size() % sizeof(T) << " bytes do not make a whole element\n";
+    }
+    return 0;
+}
+
+int generate(const std::string& path, size_t mb) {
+    FILE *out = fopen(path.c_str(), "wb");
+    if (out == nullptr) {
+        std::cerr << "Cannot open " << path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    std::vector<uint32_t> buf(1 << 18);  // 1 MB
+    uint32_t next = 0;
+    for (size_t m = 0; m < mb; ++m) {
+        for (uint32_t& x : buf) {
+            x = next++ * 2654435761u;
+        }
+        if (fwrite(buf.data(), sizeof(uint32_t), buf.size(), out) != buf.size()) {
+            std::cerr << "Write failed: " << strerror(errno) << "\n";
+            fclose(out);
+            return 1;
+        }
+    }
+    fclose(out);
+    return 0;
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc > 1 and strcmp(argv[1], "--generate") == 0) {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " --generate <file> <MB>\n";
+            return 1;
+        }
+        return generate(argv[2], atol(argv[3]));
+    }
+
+    // The positional arguments, then the options
+    std::vector<std::string> args;
+    MappedFile::Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--populate") == 0) {
+            options.populate = true;
+        } else if (strcmp(argv[i], "--hugepages") == 0) {
+            options.hugepages = true;
+        } else if (strcmp(argv[i], "--random") == 0) {
+            options.sequential = false;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <file> [u32|u64|f32] [threads] [--populate] [--hugepages] [--random]\n"
+                  << "       " << argv[0] << " --generate <file> <MB>\n";
+        return 1;
+    }
+
+    const std::string type = args.size() > 1 ? args[1] : "u32";
+    const unsigned int threads = args.size() > 2 ? atoi(args[2].c_str()) : std::thread::hardware_concurrency();
+    if (threads == 0) {
+        std::cerr << "The threads must be greater than 0\n";
+        return 1;
+    }
+
+    if (type == "u32") return run<uint32_t>(args[0], "u32", threads, options);
+    if (type == "u64") return run<uint64_t>(args[0], "u64", threads, options);
+    if (type == "f32") return run<float>(args[0], "f32", threads, options);
+
+    std::cerr << "Unknown type " << type << "\n";
+    return 1;
+} catch (const std::exception& err) {
+    std::cerr << "Error: " << err.what() << "\n";
+    return 1;
+}
@@ -0,0 +1,361 @@
+/*
+ * Primality of a stream of numbers, from a file or from stdin.
+ *
+ * 01..03 check the 10 numbers of a hard-coded array. This reads millions
+ * of numbers (decimal, separated by anything that is not a digit) and
+ * writes one line per number, in the same order than the input:
+ *
+ *      132130891 1
+ *      4 0
+ *
+ * It is a pipeline of threads connected by bounded Queues:
+ *
+ *   Reader --[to_workers]--> Worker x N --[to_writer]--> Writer
+ *      ^                                                   |
+ *      +------------------[free_batches]-------------------+
+ *
+ *  - the Reader parses the input by hand (no iostream, no strtoull) and
+ *    cuts it in batches of consecutive numbers; each batch has a
+ *    sequence number
+ *  - the Workers test the numbers of a batch with is_prime_fast
+ *    (miller_rabin.h). They finish the batches in any order
+ *  - the Writer puts the batches back in order: a batch that arrives
+ *    before its turn waits in a reorder buffer (a std::map by sequence
+ *    number) until the missing ones arrive
+ *
+ * The batches are recycled: there are a fixed number of them and the
+ * Reader takes a free one from free_batches, so if the Writer (or the
+ * output) is slow, the Reader blocks and the memory stays bounded
+ * (backpressure). The reorder buffer can never hold more than that.
+ *
+ * The counts and the throughput go to stderr, followed by the thread
+ * stats: the "blocked" column shows which stage waits for which.
+ *
+ * Usage:
+ *   ./tools/prime_stream.exe [input file or -] [workers] [batch size]
+ *
+ *   seq 1 10000000 | ./tools/prime_stream.exe > /dev/null
+ * */
+#include <iostream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+
+#include "../libs/thread.h"
+#include "../libs/queue.h"
+#include "../libs/thread_stats.h"
+#include "../libs/miller_rabin.h"
+
+namespace {
+    const size_t IO_BUFFER_SIZE = 1 << 20;
+    const unsigned int BATCHES_PER_WORKER = 4;
+}
+
+struct Batch {
+    uint64_t seq;
+    std::vector<uint64_t> nums;
+    std::vector<char> prime;
+};
+
+class Reader : public Thread {
+    private:
+        FILE *input;
+        const size_t batch_size;
+        Queue<Batch*>& free_batches;
+        Queue<Batch*>& to_workers;
+
+        uint64_t next_seq;
+        Batch *current;
+
+    public:
+        uint64_t numbers;
+        uint64_t bytes;
+        std::string error;
+
+        Reader(FILE *input, size_t batch_size,
+               Queue<Batch*>& free_batches, Queue<Batch*>& to_workers) :
+            input(input), batch_size(batch_size),
+            free_batches(free_batches), to_workers(to_workers),
+            next_seq(0), current(nullptr), numbers(0), bytes(0) {}
+
+        virtual void run() override {
+            try {
+                parse();
+            } catch (const std::exception& err) {
+                error = err.what();
+            }
+
+            // Always close: the Workers must finish even on an error
+            to_workers.close();
+        }
+
+    private:
+        void emit(uint64_t n) {
+            if (current == nullptr) {
+                current = free_batches.pop();
+                current->seq = next_seq++;
+                current->nums.clear();
+            }
+
+            current->nums.push_back(n);
+            ++numbers;
+
+            if (current->nums.size() == batch_size) {
+                flush();
+            }
+        }
+
+        void flush() {
+            if (current != nullptr) {
+                to_workers.push(current);
+                current = nullptr;
+            }
+        }
+
+        void parse() {
+            std::vector<char> buf(IO_BUFFER_SIZE);
+
+            // A number may be cut between two reads so the state of the
+            // parser lives out of the loop
+            uint64_t n = 0;
+            bool in_number = false;
+
+            size_t len;
+            while ((len = fread(buf.data(), 1, buf.size(), input)) > 0) {
+                bytes += len;
+
+                for (const char *c = buf.data(); c != buf.data() + len; ++c) {
+                    const unsigned int digit = (unsigned char)*c - '0';
+                    if (digit <= 9) {
+                        // n * 10 + digit must fit in 64 bits
+                        if (n > (UINT64_MAX - digit) / 10) {
+                            throw std::runtime_error("A number does not fit in 64 bits");
+                        }
+                        n = n * 10 + digit;
+                        in_number = true;
+                    } else if (in_number) {
+                        emit(n);
+                        n = 0;
+                        in_number = false;
+                    }
+                }
+            }
+
+            if (ferror(input)) {
+                throw std::runtime_error(std::string("Read failed: ") + strerror(errno));
+            }
+
+            if (in_number) {
+                emit(n);
+            }
+            flush();
+        }
+};
+
+class Worker : public Thread {
+    private:
+        Queue<Batch*>& to_workers;
+        Queue<Batch*>& to_writer;
+
+    public:
+        Worker(Queue<Batch*>& to_workers, Queue<Batch*>& to_writer) :
+            to_workers(to_workers), to_writer(to_writer) {}
+
+        virtual void run() override {
+            while (true) {
+                Batch *batch;
+                try {
+                    batch = to_workers.pop();
+                } catch (const ClosedQueue&) {
+                    break;
+                }
+
+                batch->prime.resize(batch->nums.size());
+                for (size_t i = 0; i < batch->nums.size(); ++i) {
+                    batch->prime[i] = is_prime_fast(batch->nums[i]);
+                }
+
+                to_writer.push(batch);
+            }
+        }
+};
+
+class Writer : public Thread {
+    private:
+        FILE *output;
+        Queue<Batch*>& to_writer;
+        Queue<Batch*>& free_batches;
+
+        std::vector<char> buf;
+        size_t used;
+
+        void write(const Batch& batch) {
+            for (size_t i = 0; i < batch.nums.size(); ++i) {
+                // 20 digits, a space, the result and a new line
+                if (used + 23 > buf.size()) {
+                    drain();
+                }
+
+                char digits[20];
+                int len = 0;
+                uint64_t n = batch.nums[i];
+                do {
+                    digits[len++] = '0' + n % 10;
+                    n /= 10;
+                } while (n);
+
+                while (len) {
+                    buf[used++] = digits[--len];
+                }
+                buf[used++] = ' ';
+                buf[used++] = batch.prime[i] ? '1' : '0';
+                buf[used++] = '\n';
+
+                primes += batch.prime[i];
+            }
+        }
+
+        void drain() {
+            if (fwrite(buf.data(), 1, used, output) != used) {
+                throw std::runtime_error(std::string("Write failed: ") + strerror(errno));
+            }
+            used = 0;
+        }
+
+    public:
+        uint64_t primes;
+        size_t max_reordered;
+        std::string error;
+
+        Writer(FILE *output, Queue<Batch*>& to_writer, Queue<Batch*>& free_batches) :
+            output(output), to_writer(to_writer), free_batches(free_batches),
+            buf(IO_BUFFER_SIZE), used(0), primes(0), max_reordered(0) {}
+
+        virtual void run() override {
+            std::map<uint64_t, Batch*> reorder;
+            uint64_t next_seq = 0;
+
+            while (true) {
+                Batch *batch;
+                try {
+                    batch = to_writer.pop();
+                } catch (const ClosedQueue&) {
+                    break;
+                }
+
+                reorder[batch->seq] = batch;
+                if (reorder.size() > max_reordered) {
+                    max_reordered = reorder.size();
+                }
+
+                // Write all the batches that are now in order
+                auto it = reorder.begin();
+                while (it != reorder.end() and it->first == next_seq) {
+                    // After an error keep recycling the batches (without
+                    // writing them) or the Reader would wait forever
+                    if (error.empty()) {
+                        try {
+                            write(*it->second);
+                        } catch (const std::exception& err) {
+                            error = err.what();
+                        }
+                    }
+                    free_batches.push(it->second);
+                    it = reorder.erase(it);
+                    ++next_seq;
+                }
+            }
+
+            if (error.empty()) {
+                try {
+                    drain();
+                } catch (const std::exception& err) {
+                    error = err.what();
+                }
+            }
+            fflush(output);
+        }
+};
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "-";
+    const unsigned int workers_cnt = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+    const size_t batch_size = argc > 3 ? atol(argv[3]) : 4096;
+
+    if (workers_cnt == 0 or batch_size == 0) {
+        std::cerr << "The workers and the batch size must be greater than 0\n";
+        return 1;
+    }
+
+    FILE *input = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (input == nullptr) {
+        std::cerr << "Cannot open " << path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    // All the batches there will ever be: this bounds the memory
+    const unsigned int batches_cnt = BATCHES_PER_WORKER * workers_cnt;
+    std::vector<Batch> batches(batches_cnt);
+
+    Queue<Batch*> free_batches(batches_cnt);
+    Queue<Batch*> to_workers(workers_cnt);
+    Queue<Batch*> to_writer(batches_cnt);
+
+    for (Batch& batch : batches) {
+        batch.nums.reserve(batch_size);
+        free_batches.push(&batch);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    Reader reader(input, batch_size, free_batches, to_workers);
+    Writer writer(stdout, to_writer, free_batches);
+    std::vector<Worker*> workers;
+
+    reader.enable_stats("reader");
+    writer.enable_stats("writer");
+    reader.start();
+    writer.start();
+    for (unsigned int i = 0; i < workers_cnt; ++i) {
+        workers.push_back(new Worker(to_workers, to_writer));
+        workers.back()->enable_stats("worker");
+        workers.back()->start();
+    }
+
+    // The Reader closes to_workers; when all the Workers are done
+    // nobody else will push to the Writer
+    reader.join();
+    for (Worker *worker : workers) {
+        worker->join();
+        delete worker;
+    }
+    to_writer.close();
+    writer.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    if (not reader.error.empty() or not writer.error.empty()) {
+        std::cerr << "Error: " << reader.error << writer.error << "\n";
+        return 1;
+    }
+
+    std::cerr << "numbers,primes,seconds,numbers_per_s,input_MB_per_s,max_reordered_batches\n"
+              << reader.numbers << "," << writer.primes << "," << elapsed.count() << ","
+              << reader.numbers / elapsed.count() << ","
+              << reader.bytes / elapsed.count() / 1e6 << ","
+              << writer.max_reordered << "\n";
+    ThreadStatsRegistry::instance().dump(std::cerr);
+
+    return 0;
+}